@@ -0,0 +1,48 @@
+#include "alloccount.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t count, size_t size);
+extern void *__real_realloc(void *pointer, size_t size);
+extern void *__real_aligned_alloc(size_t alignment, size_t size);
+
+/*
+ * Updated with relaxed atomics, philspel --threads allocates from several
+ * threads.
+ */
+static size_t allocations;
+
+static void countAllocation(void) {
+  __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size) {
+  countAllocation();
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  countAllocation();
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  countAllocation();
+  return __real_realloc(pointer, size);
+}
+
+void *__wrap_aligned_alloc(size_t alignment, size_t size) {
+  countAllocation();
+  return __real_aligned_alloc(alignment, size);
+}
+
+size_t allocationCount(void) {
+  return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+}
+
+static void __attribute__((destructor)) reportAllocations(void) {
+  if (getenv("ALLOCCOUNT") != NULL) {
+    fprintf(stderr, "allocations %zu\n", allocationCount());
+  }
+}
@@ -0,0 +1,23 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _ALLOCCOUNT_H_
+#define _ALLOCCOUNT_H_
+
+#include <stddef.h>
+
+/*
+ * Counts the calls to malloc, calloc, realloc and aligned_alloc made by a
+ * program linked with
+ *
+ *   -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=aligned_alloc
+ *
+ * and alloccount.c.  Only the calls in the program's own objects are
+ * wrapped, not the ones the C library makes for itself (stdio buffers and
+ * the like).  If the environment variable ALLOCCOUNT is set, the count is
+ * printed to stderr as "allocations n" when the program exits.
+ */
+extern size_t allocationCount(void);
+
+#endif
@@ -0,0 +1,545 @@
+/*
+ * Reproducible benchmark suite for the hashtable and philspel.  For each
+ * word length distribution it generates a dictionary and a corpus from a
+ * fixed seed, runs the HashTable insert, hit and miss microbenchmarks
+ * for every backend and then philspel (built -O2, without the sanitizer,
+ * see make bench) in several modes on the corpus.
+ *
+ * Every measurement is printed to stdout as one JSON object per line:
+ *
+ *   {"bench":"hashtable","distribution":...,"backend":...,"op":...,
+ *    "ops":...,"ns_per_op":...,"allocations":...,"peak_rss_kb":...}
+ *   {"bench":"philspel","distribution":...,"mode":...,
+ *    "dictionary_words":...,"corpus_words":...,"misspell_rate":...,
+ *    "seconds":...,"load_seconds":...,"words_per_sec":...,
+ *    "allocations":...,"peak_rss_kb":...}
+ *
+ * Each microbenchmark and philspel run is a separate process, so its peak
+ * RSS (from wait4) is its own.  The allocation counts come from
+ * alloccount.c, linked into both this program and philspel-bench.
+ * philspel runs are the best of REPEATS, load_seconds is the same run on
+ * an empty input (reading the dictionary and exiting).
+ *
+ * usage: ./benchsuite [dictionary words] [corpus words] [misspell rate]
+ *                     [lookups]
+ */
+#include "alloccount.h"
+#include "hashtable.h"
+#include "wordhash.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define DICTIONARY_FILE "benchsuite.dict"
+#define CORPUS_FILE "benchsuite.txt"
+#define PHILSPEL "./philspel-bench"
+#define REPEATS 3
+#define MAX_WORD 32
+
+/*
+ * A word length distribution, weights[i] being the relative frequency
+ * of words of i letters.  english is roughly the shape of a word list
+ * (not of running text, whose words are shorter).
+ */
+struct Distribution {
+  const char *name;
+  int weights[MAX_WORD];
+};
+
+static struct Distribution distributions[] = {
+  {"english", {0, 1, 4, 15, 40, 70, 100, 120, 125, 115, 95, 75, 55, 38, 25,
+               15, 8, 5, 3}},
+  {"short", {0, 0, 1, 1, 1, 1, 1}},
+  {"long", {[12] = 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}},
+};
+
+#define DISTRIBUTIONS (sizeof(distributions) / sizeof(distributions[0]))
+
+struct Backend {
+  const char *name;
+  int flags;
+};
+
+static struct Backend backends[] = {
+  {"chained", 0},
+  {"open", HASHTABLE_OPEN_ADDRESSING},
+  {"incremental", HASHTABLE_INCREMENTAL},
+  {"pow2", HASHTABLE_POW2},
+  {"inline", HASHTABLE_INLINE_KEYS},
+};
+
+#define BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+/*
+ * The philspel command lines measured, after the program name.
+ */
+static const char *modes[] = {
+  "",
+  "--block",
+  "--inline-keys --block",
+  "--open-addressing --block",
+  "--single-probe",
+  "--perfect --block",
+  "--bloom 0.01 --block",
+  "--dawg",
+  "--threads 4",
+};
+
+#define MODES (sizeof(modes) / sizeof(modes[0]))
+
+/*
+ * Same hash and strcmp equality that philspel uses.
+ */
+static unsigned int stringHash(void *s) {
+  return wordHash((char *)s, strlen((char *)s));
+}
+
+static int stringEquals(void *s1, void *s2) {
+  return strcmp((char *)s1, (char *)s2) == 0;
+}
+
+static unsigned long long rngState;
+
+static unsigned long long nextRandom(void) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return rngState;
+}
+
+static double uniform(void) {
+  return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int randomLength(struct Distribution *distribution) {
+  int total = 0;
+  int pick = 0;
+  int i = 0;
+  for (i = 0; i < MAX_WORD; ++i) {
+    total += distribution->weights[i];
+  }
+  pick = nextRandom() % total;
+  for (i = 0; pick >= distribution->weights[i]; ++i) {
+    pick -= distribution->weights[i];
+  }
+  return i;
+}
+
+/*
+ * Writes words distinct lowercase words drawn from distribution to
+ * DICTIONARY_FILE, one per line, and returns them.
+ */
+static char **writeDictionary(struct Distribution *distribution, int words) {
+  HashTable *seen = createHashTable(words, stringHash, stringEquals);
+  char **dictionary = malloc(sizeof(char *) * words);
+  FILE *out = fopen(DICTIONARY_FILE, "w");
+  int count = 0;
+  if (out == NULL) {
+    perror(DICTIONARY_FILE);
+    exit(1);
+  }
+  while (count < words) {
+    int length = randomLength(distribution);
+    char *word = malloc(length + 1);
+    int i = 0;
+    for (i = 0; i < length; ++i) {
+      word[i] = 'a' + nextRandom() % 26;
+    }
+    word[length] = '\0';
+    if (findData(seen, word) != NULL) {
+      free(word);
+      continue;
+    }
+    insertData(seen, word, word);
+    dictionary[count++] = word;
+    fprintf(out, "%s\n", word);
+  }
+  fclose(out);
+  freeTable(seen);
+  return dictionary;
+}
+
+/*
+ * Copies word to out with one random substitution, deletion, insertion
+ * or transposition.
+ */
+static void misspell(const char *word, char *out) {
+  int length = strlen(word);
+  int at = nextRandom() % length;
+  int edit = nextRandom() % 4;
+  if (edit == 1 && length == 1) {
+    edit = 0;
+  }
+  if (edit == 3 && length == 1) {
+    edit = 2;
+  }
+  strcpy(out, word);
+  switch (edit) {
+  case 0:
+    out[at] = 'a' + (out[at] - 'a' + 1 + nextRandom() % 25) % 26;
+    break;
+  case 1:
+    memmove(out + at, out + at + 1, length - at);
+    break;
+  case 2:
+    memmove(out + at + 1, out + at, length - at + 1);
+    out[at] = 'a' + nextRandom() % 26;
+    break;
+  default:
+    if (at == length - 1) {
+      at--;
+    }
+    out[at] = word[at + 1];
+    out[at + 1] = word[at];
+    break;
+  }
+}
+
+/*
+ * Writes a corpus of words words to CORPUS_FILE.  The words are picked
+ * from the dictionary with a roughly Zipf (log uniform) rank, a fraction
+ * misspellRate of them get one edit, sentences start with a capital
+ * letter and lines hold 8 to 15 words.
+ */
+static void writeCorpus(char **dictionary, int dictionaryWords, int words,
+                        double misspellRate) {
+  FILE *out = fopen(CORPUS_FILE, "w");
+  char word[MAX_WORD + 2];
+  int lineWords = 0;
+  int sentenceStart = 1;
+  int i = 0;
+  if (out == NULL) {
+    perror(CORPUS_FILE);
+    exit(1);
+  }
+  for (i = 0; i < words; ++i) {
+    int rank = (int)pow(dictionaryWords, uniform()) - 1;
+    if (uniform() < misspellRate) {
+      misspell(dictionary[rank], word);
+    } else {
+      strcpy(word, dictionary[rank]);
+    }
+    if (sentenceStart) {
+      word[0] = word[0] - 'a' + 'A';
+    }
+    fputs(word, out);
+    sentenceStart = nextRandom() % 12 == 0;
+    if (sentenceStart) {
+      fputc('.', out);
+    } else if (nextRandom() % 10 == 0) {
+      fputc(',', out);
+    }
+    if (++lineWords >= 8 + (int)(nextRandom() % 8)) {
+      fputc('\n', out);
+      lineWords = 0;
+    } else {
+      fputc(' ', out);
+    }
+  }
+  fputc('\n', out);
+  fclose(out);
+}
+
+/*
+ * The microbenchmark process: loads DICTIONARY_FILE into a fresh table
+ * with the given flags and prints "op ops ns allocations" lines for the
+ * inserts, then lookups hit and lookups miss lookups.  The lookup keys
+ * are copies, so no comparison is decided by pointer equality, and the
+ * misses are the dictionary words with an uppercase first letter.
+ */
+static int runTable(int flags, int lookups) {
+  FILE *in = fopen(DICTIONARY_FILE, "r");
+  char **words = NULL;
+  char **hits = NULL;
+  char **misses = NULL;
+  char word[MAX_WORD + 2];
+  int count = 0;
+  int capacity = 1024;
+  HashTable *table = NULL;
+  size_t allocations = 0;
+  long found = 0;
+  double start = 0;
+  int i = 0;
+  if (in == NULL) {
+    perror(DICTIONARY_FILE);
+    return 1;
+  }
+  words = malloc(sizeof(char *) * capacity);
+  while (fscanf(in, "%33s", word) == 1) {
+    if (count == capacity) {
+      capacity *= 2;
+      words = realloc(words, sizeof(char *) * capacity);
+    }
+    words[count++] = strdup(word);
+  }
+  fclose(in);
+  hits = malloc(sizeof(char *) * lookups);
+  misses = malloc(sizeof(char *) * lookups);
+  for (i = 0; i < lookups; ++i) {
+    hits[i] = strdup(words[nextRandom() % count]);
+    misses[i] = strdup(hits[i]);
+    misses[i][0] = misses[i][0] - 'a' + 'A';
+  }
+
+  allocations = allocationCount();
+  start = now();
+  table = createHashTableWithFlags(999, stringHash, stringEquals, flags);
+  for (i = 0; i < count; ++i) {
+    insertData(table, words[i], words[i]);
+  }
+  printf("insert %d %.2f %zu\n", count, (now() - start) / count,
+         allocationCount() - allocations);
+
+  allocations = allocationCount();
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found += findData(table, hits[i]) != NULL;
+  }
+  printf("hit %d %.2f %zu\n", lookups, (now() - start) / lookups,
+         allocationCount() - allocations);
+
+  allocations = allocationCount();
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found -= findData(table, misses[i]) == NULL;
+  }
+  printf("miss %d %.2f %zu\n", lookups, (now() - start) / lookups,
+         allocationCount() - allocations);
+
+  if (found != 0) {
+    fprintf(stderr, "benchsuite: wrong lookup results\n");
+    return 1;
+  }
+  freeTable(table);
+  for (i = 0; i < count; ++i) {
+    free(words[i]);
+  }
+  for (i = 0; i < lookups; ++i) {
+    free(hits[i]);
+    free(misses[i]);
+  }
+  free(words);
+  free(hits);
+  free(misses);
+  return 0;
+}
+
+/*
+ * Runs argv with stdin from input and stdout to /dev/null (or to a pipe
+ * that is read into output, when output is not NULL).  stderr is read
+ * for the "allocations n" line of alloccount.c.  Returns the wall clock
+ * seconds and fills in the child's peak RSS and allocation count.
+ */
+static double runChild(char **argv, const char *input, char *output,
+                       size_t outputSize, long *peakRss,
+                       size_t *allocations) {
+  int outPipe[2], errPipe[2];
+  char buffer[4096];
+  size_t used = 0;
+  struct rusage usage;
+  int status = 0;
+  double start = now();
+  pid_t pid;
+  FILE *err = NULL;
+
+  if (pipe(outPipe) < 0 || pipe(errPipe) < 0) {
+    perror("pipe");
+    exit(1);
+  }
+  pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(1);
+  }
+  if (pid == 0) {
+    int in = open(input, O_RDONLY);
+    int null = open("/dev/null", O_WRONLY);
+    if (in < 0 || null < 0) {
+      perror(input);
+      _exit(1);
+    }
+    dup2(in, 0);
+    dup2(output != NULL ? outPipe[1] : null, 1);
+    dup2(errPipe[1], 2);
+    close(outPipe[0]);
+    close(errPipe[0]);
+    setenv("ALLOCCOUNT", "1", 1);
+    execv(argv[0], argv);
+    perror(argv[0]);
+    _exit(1);
+  }
+  close(outPipe[1]);
+  close(errPipe[1]);
+  if (output != NULL) {
+    ssize_t n;
+    while ((n = read(outPipe[0], output + used, outputSize - 1 - used)) > 0) {
+      used += n;
+    }
+    output[used] = '\0';
+  }
+  close(outPipe[0]);
+  *allocations = 0;
+  err = fdopen(errPipe[0], "r");
+  while (fgets(buffer, sizeof(buffer), err) != NULL) {
+    if (sscanf(buffer, "allocations %zu", allocations) != 1) {
+      fputs(buffer, stderr);
+    }
+  }
+  fclose(err);
+  if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "benchsuite: %s failed\n", argv[0]);
+    exit(1);
+  }
+  *peakRss = usage.ru_maxrss;
+  return (now() - start) / 1e9;
+}
+
+static void benchTables(struct Distribution *distribution, int lookups) {
+  char output[4096];
+  char flags[16], lookupArgument[16];
+  unsigned int b = 0;
+  for (b = 0; b < BACKENDS; ++b) {
+    char *argv[] = {"/proc/self/exe", "--table", flags, lookupArgument,
+                    NULL};
+    char *line = NULL;
+    long peakRss = 0;
+    size_t allocations = 0;
+    snprintf(flags, sizeof(flags), "%d", backends[b].flags);
+    snprintf(lookupArgument, sizeof(lookupArgument), "%d", lookups);
+    runChild(argv, "/dev/null", output, sizeof(output), &peakRss,
+             &allocations);
+    for (line = strtok(output, "\n"); line != NULL;
+         line = strtok(NULL, "\n")) {
+      char op[16];
+      long ops = 0;
+      double ns = 0;
+      size_t opAllocations = 0;
+      if (sscanf(line, "%15s %ld %lf %zu", op, &ops, &ns,
+                 &opAllocations) != 4) {
+        continue;
+      }
+      printf("{\"bench\":\"hashtable\",\"distribution\":\"%s\","
+             "\"backend\":\"%s\",\"op\":\"%s\",\"ops\":%ld,"
+             "\"ns_per_op\":%.2f,\"allocations\":%zu,"
+             "\"peak_rss_kb\":%ld}\n",
+             distribution->name, backends[b].name, op, ops, ns,
+             opAllocations, peakRss);
+    }
+    fflush(stdout);
+  }
+}
+
+static void benchPhilspel(struct Distribution *distribution,
+                          int dictionaryWords, int corpusWords,
+                          double misspellRate) {
+  unsigned int m = 0;
+  for (m = 0; m < MODES; ++m) {
+    char options[64];
+    char *argv[8];
+    int argc = 0;
+    double best = 0, load = 0;
+    long peakRss = 0;
+    size_t allocations = 0;
+    char *option = NULL;
+    int r = 0;
+
+    argv[argc++] = PHILSPEL;
+    strcpy(options, modes[m]);
+    for (option = strtok(options, " "); option != NULL;
+         option = strtok(NULL, " ")) {
+      argv[argc++] = option;
+    }
+    argv[argc++] = DICTIONARY_FILE;
+    argv[argc] = NULL;
+
+    for (r = 0; r < REPEATS; ++r) {
+      long rss = 0;
+      size_t count = 0;
+      double seconds = runChild(argv, "/dev/null", NULL, 0, &rss, &count);
+      if (r == 0 || seconds < load) {
+        load = seconds;
+      }
+      seconds = runChild(argv, CORPUS_FILE, NULL, 0, &rss, &count);
+      if (r == 0 || seconds < best) {
+        best = seconds;
+        peakRss = rss;
+        allocations = count;
+      }
+    }
+    printf("{\"bench\":\"philspel\",\"distribution\":\"%s\","
+           "\"mode\":\"%s\",\"dictionary_words\":%d,\"corpus_words\":%d,"
+           "\"misspell_rate\":%g,\"seconds\":%.4f,\"load_seconds\":%.4f,"
+           "\"words_per_sec\":%.0f,\"allocations\":%zu,"
+           "\"peak_rss_kb\":%ld}\n",
+           distribution->name, modes[m], dictionaryWords, corpusWords,
+           misspellRate, best, load, corpusWords / best, allocations,
+           peakRss);
+    fflush(stdout);
+  }
+}
+
+int main(int argc, char **argv) {
+  int dictionaryWords = 100000;
+  int corpusWords = 2000000;
+  double misspellRate = 0.05;
+  int lookups = 2000000;
+  unsigned int d = 0;
+
+  rngState = 88172645463325252ULL;
+  if (argc == 4 && strcmp(argv[1], "--table") == 0) {
+    return runTable(atoi(argv[2]), atoi(argv[3]));
+  }
+  if (argc > 1) {
+    dictionaryWords = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    corpusWords = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    misspellRate = atof(argv[3]);
+  }
+  if (argc > 4) {
+    lookups = atoi(argv[4]);
+  }
+  if (dictionaryWords < 1 || corpusWords < 1 || lookups < 1 ||
+      misspellRate < 0 || misspellRate > 1) {
+    fprintf(stderr, "usage: %s [dictionary words] [corpus words] "
+            "[misspell rate] [lookups]\n", argv[0]);
+    return 1;
+  }
+
+  for (d = 0; d < DISTRIBUTIONS; ++d) {
+    char **dictionary = NULL;
+    int i = 0;
+    /*
+     * Every distribution starts from the same seed, so a run can be
+     * repeated (and compared) with any subset of the others.
+     */
+    rngState = 88172645463325252ULL + d;
+    dictionary = writeDictionary(&distributions[d], dictionaryWords);
+    writeCorpus(dictionary, dictionaryWords, corpusWords, misspellRate);
+    for (i = 0; i < dictionaryWords; ++i) {
+      free(dictionary[i]);
+    }
+    free(dictionary);
+    benchTables(&distributions[d], lookups);
+    benchPhilspel(&distributions[d], dictionaryWords, corpusWords,
+                  misspellRate);
+  }
+  unlink(DICTIONARY_FILE);
+  unlink(CORPUS_FILE);
+  return 0;
+}
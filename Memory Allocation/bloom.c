@@ -0,0 +1,93 @@
+#include "bloom.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define BLOCK_WORDS (BLOOM_BLOCK_BITS / 64)
+
+/*
+ * The murmur3 64 bit finalizer, applied to the 32 bit hash it spreads it
+ * over all 64 bits.
+ */
+static uint64_t mixHash(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+BloomFilter *createBloomFilter(size_t keys, double falsePositiveRate) {
+  BloomFilter *filter = malloc(sizeof(BloomFilter));
+  /*
+   * The classic sizing: bits per key -ln(p) / ln(2)^2 and ln(2) hashes
+   * per bit per key.
+   */
+  double bitsPerKey = -log(falsePositiveRate) / (M_LN2 * M_LN2);
+  size_t bits = (size_t)(bitsPerKey * (keys ? keys : 1)) + 1;
+  filter->blockCount = (bits + BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS;
+  filter->hashes = (int)(bitsPerKey * M_LN2 + 0.5);
+  if (filter->hashes < 1) {
+    filter->hashes = 1;
+  }
+  if (filter->hashes > 16) {
+    filter->hashes = 16;
+  }
+  filter->blocks = aligned_alloc(64, (size_t)filter->blockCount * 64);
+  memset(filter->blocks, 0, (size_t)filter->blockCount * 64);
+  return filter;
+}
+
+/*
+ * The block of a hash comes from the high bits of the mixed hash, the
+ * bits inside it from the low bits by double hashing.
+ */
+static uint64_t *blockOf(BloomFilter *filter, uint64_t mixed) {
+  uint32_t block = (uint32_t)(((mixed >> 32) * filter->blockCount) >> 32);
+  return filter->blocks + (size_t)block * BLOCK_WORDS;
+}
+
+void addToBloomFilter(BloomFilter *filter, unsigned int hash) {
+  uint64_t mixed = mixHash(hash);
+  uint64_t *block = blockOf(filter, mixed);
+  uint32_t bit = (uint32_t)mixed;
+  uint32_t step = (uint32_t)(mixed >> 9) | 1;
+  int i = 0;
+  for (i = 0; i < filter->hashes; ++i) {
+    block[(bit / 64) % BLOCK_WORDS] |= 1ULL << (bit % 64);
+    bit += step;
+  }
+}
+
+int bloomFilterMayContain(BloomFilter *filter, unsigned int hash) {
+  uint64_t mixed = mixHash(hash);
+  uint64_t *block = blockOf(filter, mixed);
+  uint32_t bit = (uint32_t)mixed;
+  uint32_t step = (uint32_t)(mixed >> 9) | 1;
+  int i = 0;
+  for (i = 0; i < filter->hashes; ++i) {
+    if ((block[(bit / 64) % BLOCK_WORDS] & (1ULL << (bit % 64))) == 0) {
+      return 0;
+    }
+    bit += step;
+  }
+  return 1;
+}
+
+size_t bloomFilterBytes(BloomFilter *filter) {
+  return (size_t)filter->blockCount * 64;
+}
+
+void printBloomFilterStats(BloomFilter *filter, size_t keys, FILE *out) {
+  fprintf(out, "bloom filter: %zu bytes, %.1f bits per key, %d hashes\n",
+          bloomFilterBytes(filter),
+          keys ? 8.0 * bloomFilterBytes(filter) / keys : 0.0,
+          filter->hashes);
+}
+
+void freeBloomFilter(BloomFilter *filter) {
+  free(filter->blocks);
+  free(filter);
+}
@@ -0,0 +1,47 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _BLOOM_H_
+#define _BLOOM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A blocked Bloom filter over key hashes, to answer "definitely not in
+ * the set" without touching the set itself.  Each key sets hashes bits,
+ * all inside one 64 byte block picked by its hash, so a lookup is a
+ * single cache line.  That costs a somewhat higher false positive rate
+ * than a classic Bloom filter of the same size.
+ *
+ * The filter is sized for keys keys at falsePositiveRate; it takes the
+ * keys' 32 bit hashes (the ones the HashTable uses) and mixes them
+ * itself, so a poorly mixed hash such as djb2 is fine.
+ */
+#define BLOOM_BLOCK_BITS 512
+
+typedef struct BloomFilter {
+  uint64_t *blocks;
+  uint32_t blockCount;
+  int hashes;
+} BloomFilter;
+
+extern BloomFilter *createBloomFilter(size_t keys, double falsePositiveRate);
+
+extern void addToBloomFilter(BloomFilter *filter, unsigned int hash);
+
+/*
+ * 0 if no key with this hash was added, 1 if one may have been.
+ */
+extern int bloomFilterMayContain(BloomFilter *filter, unsigned int hash);
+
+extern size_t bloomFilterBytes(BloomFilter *filter);
+
+extern void printBloomFilterStats(BloomFilter *filter, size_t keys,
+                                  FILE *out);
+
+extern void freeBloomFilter(BloomFilter *filter);
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * Multi threaded benchmark for the concurrent hashtable.  The table is
+ * first filled by several writer threads at once (which also exercises
+ * the resizes), then the lookup throughput is measured for 1, 2, 4, ...
+ * threads, next to a plain HashTable behind a single mutex.
+ *
+ * Last, a mixed phase looks up keys while writers insert more of them
+ * through several resizes, with more reader threads than the table has
+ * reader slots, and checks that no lookup misses a key that was in the
+ * table before the phase began.
+ *
+ * usage: ./chashbench [keys] [lookups per thread] [max threads]
+ */
+#include "chashtable.h"
+#include "wordhash.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WRITERS 4
+
+/*
+ * More readers than reader slots, so some of them go without one.
+ */
+#define MIXED_READERS (CHASHTABLE_THREADS + 8)
+
+struct Worker {
+  pthread_t thread;
+  char **words;
+  int first;
+  int count;
+  long found;
+};
+
+static ConcurrentHashTable *concurrentTable;
+static HashTable *lockedTable;
+static pthread_mutex_t tableLock = PTHREAD_MUTEX_INITIALIZER;
+static int lookupsPerThread;
+static atomic_int writing;
+
+/*
+ * Same hash and strcmp equality that philspel uses.
+ */
+static unsigned int stringHash(void *s) {
+  return wordHash((char *)s, strlen((char *)s));
+}
+
+static int stringEquals(void *s1, void *s2) {
+  return strcmp((char *)s1, (char *)s2) == 0;
+}
+
+static char *makeWord(int i) {
+  char *word = malloc(16);
+  snprintf(word, 16, "w%x", (unsigned int)(i * 2654435761U));
+  return word;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void *insertWorker(void *arg) {
+  struct Worker *worker = arg;
+  int i = 0;
+  for (i = worker->first; i < worker->first + worker->count; ++i) {
+    insertConcurrentData(concurrentTable, worker->words[i], worker->words[i]);
+  }
+  return NULL;
+}
+
+static void *concurrentWorker(void *arg) {
+  struct Worker *worker = arg;
+  unsigned int at = worker->first;
+  int i = 0;
+  for (i = 0; i < lookupsPerThread; ++i) {
+    at = at * 1103515245U + 12345U;
+    worker->found +=
+        findConcurrentData(concurrentTable,
+                           worker->words[at % worker->count]) != NULL;
+  }
+  return NULL;
+}
+
+/*
+ * A reader of the mixed phase: looks up the count keys the table started
+ * with until the writers are done, and stops the benchmark if one of
+ * them is not found.
+ */
+static void *mixedWorker(void *arg) {
+  struct Worker *worker = arg;
+  unsigned int at = worker->first;
+  char *word = NULL;
+  do {
+    at = at * 1103515245U + 12345U;
+    word = worker->words[at % worker->count];
+    if (findConcurrentData(concurrentTable, word) != word) {
+      fprintf(stderr, "key %s missing during the inserts\n", word);
+      exit(1);
+    }
+    // let the writers run on machines with fewer cores than readers
+    if (++worker->found % 256 == 0) {
+      sched_yield();
+    }
+  } while (atomic_load(&writing));
+  return NULL;
+}
+
+static void *lockedWorker(void *arg) {
+  struct Worker *worker = arg;
+  unsigned int at = worker->first;
+  int i = 0;
+  for (i = 0; i < lookupsPerThread; ++i) {
+    at = at * 1103515245U + 12345U;
+    pthread_mutex_lock(&tableLock);
+    worker->found +=
+        findData(lockedTable, worker->words[at % worker->count]) != NULL;
+    pthread_mutex_unlock(&tableLock);
+  }
+  return NULL;
+}
+
+/*
+ * Runs threads copies of work and returns the lookups per microsecond.
+ */
+static double runLookups(void *(*work)(void *), int threads, char **words,
+                         int keys) {
+  struct Worker *workers = calloc(threads, sizeof(struct Worker));
+  double start = now();
+  long found = 0;
+  int i = 0;
+  for (i = 0; i < threads; ++i) {
+    workers[i].words = words;
+    workers[i].first = i + 1;
+    workers[i].count = keys;
+    pthread_create(&workers[i].thread, NULL, work, &workers[i]);
+  }
+  for (i = 0; i < threads; ++i) {
+    pthread_join(workers[i].thread, NULL);
+    found += workers[i].found;
+  }
+  start = now() - start;
+  free(workers);
+  if (found != (long)threads * lookupsPerThread) {
+    fprintf(stderr, "lost keys: found %ld of %ld\n", found,
+            (long)threads * lookupsPerThread);
+    exit(1);
+  }
+  return (double)threads * lookupsPerThread / (start / 1e3);
+}
+
+/*
+ * Starts with keys / 16 of the keys in a fresh table, so inserting the
+ * rest from WRITERS threads resizes it four times, while MIXED_READERS
+ * threads look up the keys it started with.
+ */
+static void runMixed(char **words, int keys) {
+  struct Worker writers[WRITERS];
+  struct Worker *readers = calloc(MIXED_READERS, sizeof(struct Worker));
+  int preloaded = keys / 16;
+  double start = 0;
+  long lookups = 0;
+  int i = 0;
+
+  concurrentTable = createConcurrentHashTable(999, stringHash, stringEquals);
+  for (i = 0; i < preloaded; ++i) {
+    insertConcurrentData(concurrentTable, words[i], words[i]);
+  }
+  atomic_store(&writing, 1);
+  for (i = 0; i < MIXED_READERS; ++i) {
+    readers[i].words = words;
+    readers[i].first = i + 1;
+    readers[i].count = preloaded;
+    if (pthread_create(&readers[i].thread, NULL, mixedWorker, &readers[i]) !=
+        0) {
+      fprintf(stderr, "could not start %d reader threads\n", MIXED_READERS);
+      exit(1);
+    }
+  }
+  start = now();
+  for (i = 0; i < WRITERS; ++i) {
+    writers[i].words = words;
+    writers[i].first = preloaded + (long)(keys - preloaded) * i / WRITERS;
+    writers[i].count =
+        preloaded + (long)(keys - preloaded) * (i + 1) / WRITERS -
+        writers[i].first;
+    pthread_create(&writers[i].thread, NULL, insertWorker, &writers[i]);
+  }
+  for (i = 0; i < WRITERS; ++i) {
+    pthread_join(writers[i].thread, NULL);
+  }
+  start = now() - start;
+  atomic_store(&writing, 0);
+  for (i = 0; i < MIXED_READERS; ++i) {
+    pthread_join(readers[i].thread, NULL);
+    lookups += readers[i].found;
+  }
+  for (i = 0; i < keys; ++i) {
+    if (findConcurrentData(concurrentTable, words[i]) != words[i]) {
+      fprintf(stderr, "key %s missing after the mixed inserts\n", words[i]);
+      exit(1);
+    }
+  }
+  printf("mixed: %d readers found all of %d keys in %ld lookups while %d "
+         "writers inserted %d more in %.1f ms\n",
+         MIXED_READERS, preloaded, lookups, WRITERS, keys - preloaded,
+         start / 1e6);
+  freeConcurrentTable(concurrentTable);
+  free(readers);
+}
+
+int main(int argc, char **argv) {
+  int keys = argc > 1 ? atoi(argv[1]) : 1000000;
+  int maxThreads = argc > 3 ? atoi(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+  char **words = malloc(sizeof(char *) * keys);
+  struct Worker writers[WRITERS];
+  int threads = 0;
+  int i = 0;
+
+  lookupsPerThread = argc > 2 ? atoi(argv[2]) : 2000000;
+  for (i = 0; i < keys; ++i) {
+    words[i] = makeWord(i);
+  }
+
+  concurrentTable = createConcurrentHashTable(999, stringHash, stringEquals);
+  lockedTable = createHashTable(999, stringHash, stringEquals);
+  for (i = 0; i < WRITERS; ++i) {
+    writers[i].words = words;
+    writers[i].first = (long)keys * i / WRITERS;
+    writers[i].count = (long)keys * (i + 1) / WRITERS - writers[i].first;
+    pthread_create(&writers[i].thread, NULL, insertWorker, &writers[i]);
+  }
+  for (i = 0; i < keys; ++i) {
+    insertData(lockedTable, words[i], words[i]);
+  }
+  for (i = 0; i < WRITERS; ++i) {
+    pthread_join(writers[i].thread, NULL);
+  }
+  for (i = 0; i < keys; ++i) {
+    if (findConcurrentData(concurrentTable, words[i]) != words[i]) {
+      fprintf(stderr, "key %s missing after the parallel insert\n", words[i]);
+      return 1;
+    }
+  }
+
+  printf("%8s %18s %18s\n", "threads", "lockfree Mops/s", "mutex Mops/s");
+  for (threads = 1; threads <= maxThreads; threads *= 2) {
+    printf("%8d %18.2f %18.2f\n", threads,
+           runLookups(concurrentWorker, threads, words, keys),
+           runLookups(lockedWorker, threads, words, keys));
+  }
+
+  freeConcurrentTable(concurrentTable);
+  freeTable(lockedTable);
+  runMixed(words, keys);
+  for (i = 0; i < keys; ++i) {
+    free(words[i]);
+  }
+  free(words);
+  return 0;
+}
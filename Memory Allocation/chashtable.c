@@ -0,0 +1,298 @@
+
+#include "chashtable.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define CACHE_LINE 64
+
+/*
+ * One generation of the table: the bucket array and the slabs its
+ * buckets were carved from, one pool per stripe so writers holding
+ * different stripes never share an allocator.  Buckets are never
+ * modified once published, a resize copies them into the next generation.
+ */
+struct Generation {
+  _Atomic(struct HashBucket *) *data;
+  unsigned int size;
+  SlabPool buckets[CHASHTABLE_STRIPES];
+};
+
+struct Stripe {
+  pthread_mutex_t lock;
+} __attribute__((aligned(CACHE_LINE)));
+
+/*
+ * The epoch a reader entered the table in, or 0 while it is outside.
+ * Padded so readers on different cores do not share a cache line.
+ */
+struct Reader {
+  atomic_ulong epoch;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct ConcurrentHashTable {
+  unsigned int (*hashFunction)(void *);
+  int (*equalFunction)(void *, void *);
+  _Atomic(struct Generation *) current;
+  atomic_int used;
+  atomic_ulong epoch;
+  struct Stripe stripes[CHASHTABLE_STRIPES];
+  struct Reader readers[CHASHTABLE_THREADS];
+};
+
+/*
+ * Reader slots belong to threads and are shared by all tables.  A thread
+ * takes one the first time it reads and gives it back when it exits (the
+ * destructor of slotKey), so a pool that keeps replacing its threads
+ * keeps reusing the same slots.
+ */
+static pthread_mutex_t slotLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t slotKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t slotKey;
+static int freeSlots[CHASHTABLE_THREADS];
+static int freeSlotCount;
+static int nextThreadSlot;
+static _Thread_local int threadSlot = -1;
+
+/*
+ * slot is the slot plus one, as pthread only calls destructors for
+ * values that are not NULL.
+ */
+static void releaseThreadSlot(void *slot) {
+  pthread_mutex_lock(&slotLock);
+  freeSlots[freeSlotCount++] = (int)(intptr_t)slot - 1;
+  pthread_mutex_unlock(&slotLock);
+  threadSlot = -1;
+}
+
+static void createSlotKey(void) {
+  pthread_key_create(&slotKey, releaseThreadSlot);
+}
+
+/*
+ * A slot for the calling thread, or -1 while all CHASHTABLE_THREADS are
+ * taken by live threads.
+ */
+static int acquireThreadSlot(void) {
+  int slot = -1;
+  pthread_once(&slotKeyOnce, createSlotKey);
+  pthread_mutex_lock(&slotLock);
+  if (freeSlotCount > 0) {
+    slot = freeSlots[--freeSlotCount];
+  } else if (nextThreadSlot < CHASHTABLE_THREADS) {
+    slot = nextThreadSlot++;
+  }
+  pthread_mutex_unlock(&slotLock);
+  if (slot >= 0) {
+    pthread_setspecific(slotKey, (void *)(intptr_t)(slot + 1));
+  }
+  return slot;
+}
+
+/*
+ * The bucket index keeps its low bits from the mixed hash, and the
+ * stripe is those low bits again, so all the buckets of a stripe stay in
+ * that stripe across resizes.
+ */
+static unsigned int mixHash(unsigned int hash) {
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bU;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35U;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+static struct Generation *createGeneration(unsigned int size) {
+  struct Generation *generation = malloc(sizeof(struct Generation));
+  unsigned int i = 0;
+  generation->size = size;
+  generation->data = malloc(sizeof(generation->data[0]) * size);
+  for (i = 0; i < size; ++i) {
+    atomic_init(&generation->data[i], NULL);
+  }
+  for (i = 0; i < CHASHTABLE_STRIPES; ++i) {
+    initSlabPool(&generation->buckets[i], sizeof(struct HashBucket));
+  }
+  return generation;
+}
+
+static void freeGeneration(struct Generation *generation) {
+  int i = 0;
+  for (i = 0; i < CHASHTABLE_STRIPES; ++i) {
+    freeSlabPool(&generation->buckets[i]);
+  }
+  free(generation->data);
+  free(generation);
+}
+
+/*
+ * Links a new bucket in front of its chain.  The bucket is filled in
+ * before the release store of the chain head, so a reader that sees the
+ * bucket also sees its contents.  The caller holds the stripe's lock.
+ */
+static void linkBucket(struct Generation *generation, unsigned int stripe,
+                       unsigned int hash, void *key, void *data) {
+  unsigned int location = mixHash(hash) & (generation->size - 1);
+  struct HashBucket *bucket = slabAlloc(&generation->buckets[stripe]);
+  bucket->key = key;
+  bucket->data = data;
+  bucket->hash = hash;
+  bucket->next = atomic_load_explicit(&generation->data[location],
+                                      memory_order_relaxed);
+  atomic_store_explicit(&generation->data[location], bucket,
+                        memory_order_release);
+}
+
+ConcurrentHashTable *createConcurrentHashTable(
+    int size, unsigned int (*hashFunction)(void *),
+    int (*equalFunction)(void *, void *)) {
+  ConcurrentHashTable *newTable =
+      aligned_alloc(CACHE_LINE, sizeof(ConcurrentHashTable));
+  unsigned int pow2 = CHASHTABLE_STRIPES;
+  int i = 0;
+  while (pow2 < (unsigned int)size) {
+    pow2 *= 2;
+  }
+  newTable->hashFunction = hashFunction;
+  newTable->equalFunction = equalFunction;
+  atomic_init(&newTable->current, createGeneration(pow2));
+  atomic_init(&newTable->used, 0);
+  atomic_init(&newTable->epoch, 1);
+  for (i = 0; i < CHASHTABLE_STRIPES; ++i) {
+    pthread_mutex_init(&newTable->stripes[i].lock, NULL);
+  }
+  for (i = 0; i < CHASHTABLE_THREADS; ++i) {
+    atomic_init(&newTable->readers[i].epoch, 0);
+  }
+  return newTable;
+}
+
+void freeConcurrentTable(ConcurrentHashTable *table) {
+  int i = 0;
+  for (i = 0; i < CHASHTABLE_STRIPES; ++i) {
+    pthread_mutex_destroy(&table->stripes[i].lock);
+  }
+  freeGeneration(atomic_load(&table->current));
+  free(table);
+}
+
+/*
+ * Waits until no reader can still hold a pointer to a generation that
+ * was replaced before this call.  Readers that enter from now on read
+ * the new epoch, and so the new generation.  Readers without a slot do
+ * not count here: they hold their stripe's lock, so they were out of the
+ * old generation once the resize had every stripe.
+ */
+static void waitForReaders(ConcurrentHashTable *table) {
+  unsigned long epoch = atomic_fetch_add(&table->epoch, 1) + 1;
+  int i = 0;
+  for (i = 0; i < CHASHTABLE_THREADS; ++i) {
+    unsigned long seen = 0;
+    while ((seen = atomic_load(&table->readers[i].epoch)) != 0 &&
+           seen < epoch) {
+      sched_yield();
+    }
+  }
+}
+
+/*
+ * Doubles the table.  Every stripe is locked while the buckets are
+ * copied, so the copy is complete when the new generation is published.
+ */
+static void resizeConcurrent(ConcurrentHashTable *table) {
+  struct Generation *old = NULL;
+  struct Generation *generation = NULL;
+  unsigned int i = 0;
+  for (i = 0; i < CHASHTABLE_STRIPES; ++i) {
+    pthread_mutex_lock(&table->stripes[i].lock);
+  }
+  old = atomic_load_explicit(&table->current, memory_order_relaxed);
+  /*
+   * Another writer may have resized while we waited for the locks.
+   */
+  if ((unsigned int)atomic_load(&table->used) > old->size) {
+    generation = createGeneration(old->size * 2);
+    for (i = 0; i < old->size; ++i) {
+      struct HashBucket *at =
+          atomic_load_explicit(&old->data[i], memory_order_relaxed);
+      while (at != NULL) {
+        linkBucket(generation, i & (CHASHTABLE_STRIPES - 1), at->hash,
+                   at->key, at->data);
+        at = at->next;
+      }
+    }
+    atomic_store(&table->current, generation);
+  }
+  for (i = 0; i < CHASHTABLE_STRIPES; ++i) {
+    pthread_mutex_unlock(&table->stripes[i].lock);
+  }
+  if (generation != NULL) {
+    waitForReaders(table);
+    freeGeneration(old);
+  }
+}
+
+void insertConcurrentData(ConcurrentHashTable *table, void *key,
+                          void *data) {
+  unsigned int hash = (table->hashFunction)(key);
+  unsigned int stripe = mixHash(hash) & (CHASHTABLE_STRIPES - 1);
+  struct Generation *generation = NULL;
+  unsigned int size = 0;
+  pthread_mutex_lock(&table->stripes[stripe].lock);
+  generation = atomic_load_explicit(&table->current, memory_order_relaxed);
+  linkBucket(generation, stripe, hash, key, data);
+  /*
+   * Once unlocked the generation may be replaced and freed at any time.
+   */
+  size = generation->size;
+  pthread_mutex_unlock(&table->stripes[stripe].lock);
+  if ((unsigned int)atomic_fetch_add(&table->used, 1) + 1 > size) {
+    resizeConcurrent(table);
+  }
+}
+
+void *findConcurrentData(ConcurrentHashTable *table, void *key) {
+  unsigned int hash = (table->hashFunction)(key);
+  unsigned int stripe = mixHash(hash) & (CHASHTABLE_STRIPES - 1);
+  struct Reader *reader = NULL;
+  struct Generation *generation = NULL;
+  struct HashBucket *lookAt = NULL;
+  void *found = NULL;
+  if (threadSlot < 0) {
+    threadSlot = acquireThreadSlot();
+  }
+  /*
+   * Announce the epoch before loading the generation (both sequentially
+   * consistent), so a writer that does not see us yet has already
+   * published the generation we are about to load.  Without a slot, hold
+   * the stripe's lock instead, which keeps a resize out until we are done.
+   */
+  if (threadSlot >= 0) {
+    reader = &table->readers[threadSlot];
+    atomic_store(&reader->epoch, atomic_load(&table->epoch));
+  } else {
+    pthread_mutex_lock(&table->stripes[stripe].lock);
+  }
+  generation = atomic_load(&table->current);
+  lookAt = atomic_load_explicit(
+      &generation->data[mixHash(hash) & (generation->size - 1)],
+      memory_order_acquire);
+  while (lookAt != NULL) {
+    if (lookAt->hash == hash &&
+        (table->equalFunction)(key, lookAt->key) != 0) {
+      found = lookAt->data;
+      break;
+    }
+    lookAt = lookAt->next;
+  }
+  if (reader != NULL) {
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+  } else {
+    pthread_mutex_unlock(&table->stripes[stripe].lock);
+  }
+  return found;
+}
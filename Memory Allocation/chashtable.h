@@ -0,0 +1,51 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _CHASHTABLE_H_
+#define _CHASHTABLE_H_
+
+#include "hashtable.h"
+
+/*
+ * A thread safe variant of the HashTable interface, for sharing one
+ * insert only table (such as the dictionary) between threads.
+ *
+ * findConcurrentData is wait free: it never takes a lock, it just walks
+ * chains whose heads are published atomically.  Writers take one of
+ * CHASHTABLE_STRIPES locks, picked by the key's hash, so inserts of
+ * different keys mostly do not contend.  A resize takes every stripe,
+ * copies the table into a new generation and publishes it; the old
+ * generation is freed once every reader that might still be walking it
+ * has left (epoch based reclamation).
+ *
+ * Each of the first CHASHTABLE_THREADS threads reading at the same time
+ * gets a slot for its epoch, given back when the thread exits.  Readers
+ * beyond that are not wait free: they take the lock of their key's
+ * stripe for the lookup, which a resize has to get before it can
+ * replace the generation.
+ */
+#define CHASHTABLE_STRIPES 64
+#define CHASHTABLE_THREADS 256
+
+typedef struct ConcurrentHashTable ConcurrentHashTable;
+
+extern ConcurrentHashTable *createConcurrentHashTable(
+    int size, unsigned int (*hashFunction)(void *),
+    int (*equalFunction)(void *, void *));
+
+/*
+ * As with insertData, inserting a key that already exists is undefined
+ * behavior.
+ */
+extern void insertConcurrentData(ConcurrentHashTable *table, void *key,
+                                 void *data);
+
+extern void *findConcurrentData(ConcurrentHashTable *table, void *key);
+
+/*
+ * Must not race with any other call on the table.
+ */
+extern void freeConcurrentTable(ConcurrentHashTable *table);
+
+#endif
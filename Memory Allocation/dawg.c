@@ -0,0 +1,258 @@
+#include "dawg.h"
+#include "hashtable.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define N 64
+
+const unsigned char dawgLetterCodes[256] = {
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+  15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, N, N, N, N, N,
+  N, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+  41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+  N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+};
+
+#undef N
+
+/*
+ * A node of the trie while it is being built and minimized.  Its edges
+ * are in the order they were added, which (the words being sorted) is
+ * also the order of their letters.
+ */
+struct BuildNode {
+  struct BuildNode **children;
+  unsigned char *letters;
+  int count;
+  int capacity;
+  int final;
+  uint32_t offset;
+};
+
+/*
+ * The path of the previous word whose nodes have not been checked
+ * against the register yet: entry i is the edge from depth i to i + 1.
+ */
+struct Unchecked {
+  struct BuildNode *parent;
+  struct BuildNode *child;
+};
+
+/*
+ * Two nodes are equivalent when they are both final or both not, and
+ * have the same letters leading to the same (already unique) children.
+ */
+static unsigned int nodeHash(void *p) {
+  struct BuildNode *node = p;
+  uint64_t hash = node->final;
+  int i = 0;
+  for (i = 0; i < node->count; ++i) {
+    hash = (hash ^ node->letters[i]) * 0x100000001b3ULL;
+    hash = (hash ^ (uintptr_t)node->children[i]) * 0x100000001b3ULL;
+  }
+  return (unsigned int)(hash ^ (hash >> 32));
+}
+
+static int nodeEquals(void *p1, void *p2) {
+  struct BuildNode *a = p1;
+  struct BuildNode *b = p2;
+  return a->final == b->final && a->count == b->count &&
+         memcmp(a->letters, b->letters, a->count) == 0 &&
+         memcmp(a->children, b->children,
+                a->count * sizeof(struct BuildNode *)) == 0;
+}
+
+static void freeNode(struct BuildNode *node) {
+  free(node->children);
+  free(node->letters);
+  free(node);
+}
+
+static void addEdge(struct BuildNode *node, unsigned char letter,
+                    struct BuildNode *child) {
+  if (node->count == node->capacity) {
+    node->capacity = node->capacity ? 2 * node->capacity : 2;
+    node->children = realloc(node->children,
+                             node->capacity * sizeof(struct BuildNode *));
+    node->letters = realloc(node->letters, node->capacity);
+  }
+  node->letters[node->count] = letter;
+  node->children[node->count++] = child;
+}
+
+static int compareWords(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int lettersOnly(const char *word) {
+  for (; *word != '\0'; ++word) {
+    if (dawgLetterCodes[(unsigned char)*word] > 51) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Replaces each unchecked node deeper than depth by an equivalent one
+ * from the register, or registers it if it is the first of its kind.
+ * Deepest first, so a node's children are always unique by the time it
+ * is looked up itself.
+ */
+static void minimize(struct Unchecked *unchecked, int *uncheckedCount,
+                     int depth, HashTable *registered,
+                     struct BuildNode ***nodes, int *nodeCount,
+                     int *nodeCapacity) {
+  while (*uncheckedCount > depth) {
+    struct Unchecked *top = &unchecked[--*uncheckedCount];
+    struct BuildNode *existing = findData(registered, top->child);
+    if (existing != NULL) {
+      top->parent->children[top->parent->count - 1] = existing;
+      freeNode(top->child);
+      continue;
+    }
+    insertData(registered, top->child, top->child);
+    if (*nodeCount == *nodeCapacity) {
+      *nodeCapacity = 2 * *nodeCapacity + 1024;
+      *nodes = realloc(*nodes, *nodeCapacity * sizeof(struct BuildNode *));
+    }
+    (*nodes)[(*nodeCount)++] = top->child;
+  }
+}
+
+/*
+ * The incremental construction of Daciuk et al.: the words are added in
+ * sorted order, and once a word is added, the part of the previous word
+ * past their common prefix can no longer change, so it is minimized
+ * right away.  The trie never holds more than one unminimized path.
+ */
+Dawg *createDawg(char **words, int count) {
+  char **sorted = malloc((count + 1) * sizeof(char *));
+  HashTable *registered = createHashTable(count + 1, nodeHash, nodeEquals);
+  struct BuildNode *root = calloc(1, sizeof(struct BuildNode));
+  struct BuildNode **nodes = NULL;
+  int nodeCount = 0;
+  int nodeCapacity = 0;
+  struct Unchecked *unchecked = NULL;
+  int uncheckedCount = 0;
+  int uncheckedCapacity = 0;
+  const char *previous = "";
+  Dawg *dawg = NULL;
+  uint64_t edgeCount = 2;
+  int sortedCount = 0;
+  int i = 0, j = 0;
+
+  for (i = 0; i < count; ++i) {
+    if (lettersOnly(words[i])) {
+      sorted[sortedCount++] = words[i];
+    }
+  }
+  qsort(sorted, sortedCount, sizeof(char *), compareWords);
+
+  dawg = calloc(1, sizeof(Dawg));
+  for (i = 0; i < sortedCount; ++i) {
+    const char *word = sorted[i];
+    struct BuildNode *node = NULL;
+    int length = strlen(word);
+    int prefix = 0;
+    if (i > 0 && strcmp(word, previous) == 0) {
+      continue;
+    }
+    while (word[prefix] != '\0' && word[prefix] == previous[prefix]) {
+      prefix++;
+    }
+    minimize(unchecked, &uncheckedCount, prefix, registered, &nodes,
+             &nodeCount, &nodeCapacity);
+    node = uncheckedCount == 0 ? root : unchecked[uncheckedCount - 1].child;
+    if (length > uncheckedCapacity) {
+      uncheckedCapacity = 2 * length;
+      unchecked = realloc(unchecked,
+                          uncheckedCapacity * sizeof(struct Unchecked));
+    }
+    for (j = prefix; j < length; ++j) {
+      struct BuildNode *child = calloc(1, sizeof(struct BuildNode));
+      addEdge(node, dawgLetterCodes[(unsigned char)word[j]], child);
+      unchecked[uncheckedCount].parent = node;
+      unchecked[uncheckedCount++].child = child;
+      node = child;
+    }
+    node->final = 1;
+    dawg->words++;
+    previous = word;
+  }
+  minimize(unchecked, &uncheckedCount, 0, registered, &nodes, &nodeCount,
+           &nodeCapacity);
+  freeTable(registered);
+  free(unchecked);
+  free(sorted);
+
+  // lay the nodes with edges out one after the other, after the two
+  // reserved edges (DAWG_DEAD and DAWG_START)
+  for (i = 0; i <= nodeCount; ++i) {
+    struct BuildNode *node = i < nodeCount ? nodes[i] : root;
+    node->offset = node->count > 0 ? edgeCount : 0;
+    edgeCount += node->count;
+  }
+  if (edgeCount > DAWG_MAX_EDGES) {
+    free(dawg);
+    dawg = NULL;
+  } else {
+    dawg->edgeCount = edgeCount;
+    dawg->nodeCount = nodeCount + 1;
+    dawg->edges = malloc(edgeCount * sizeof(uint32_t));
+    dawg->edges[DAWG_DEAD] = 0;
+    dawg->edges[DAWG_START] = root->offset << 8 | 1 << 7;
+    for (i = 0; i <= nodeCount; ++i) {
+      struct BuildNode *node = i < nodeCount ? nodes[i] : root;
+      for (j = 0; j < node->count; ++j) {
+        struct BuildNode *child = node->children[j];
+        dawg->edges[node->offset + j] =
+            node->letters[j] | child->final << 6 |
+            (j == node->count - 1) << 7 | child->offset << 8;
+      }
+    }
+  }
+
+  for (i = 0; i < nodeCount; ++i) {
+    freeNode(nodes[i]);
+  }
+  freeNode(root);
+  free(nodes);
+  return dawg;
+}
+
+int dawgContains(const Dawg *dawg, const char *word, size_t length) {
+  uint32_t cursor = DAWG_START;
+  size_t i = 0;
+  for (i = 0; i < length && cursor != DAWG_DEAD; ++i) {
+    cursor = dawgStep(dawg, cursor, word[i]);
+  }
+  return dawgIsWord(dawg, cursor);
+}
+
+size_t dawgBytes(const Dawg *dawg) {
+  return dawg->edgeCount * sizeof(uint32_t);
+}
+
+void printDawgStats(const Dawg *dawg, FILE *out) {
+  fprintf(out, "dawg: %u words, %u nodes, %u edges\n", dawg->words,
+          dawg->nodeCount, dawg->edgeCount);
+  fprintf(out, "memory: %zu bytes, %.2f bytes per word\n", dawgBytes(dawg),
+          dawg->words ? (double)dawgBytes(dawg) / dawg->words : 0.0);
+}
+
+void freeDawg(Dawg *dawg) {
+  free(dawg->edges);
+  free(dawg);
+}
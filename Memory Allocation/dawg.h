@@ -0,0 +1,105 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _DAWG_H_
+#define _DAWG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A read only set of words stored as a minimized DAWG (directed acyclic
+ * word graph): a trie whose equal suffixes are shared, so "walking",
+ * "talking" and "walked" share the "ing" and "ed" tails.  The whole graph
+ * is one array of 4 byte edges and no words are stored anywhere else.
+ *
+ * A node is the run of its outgoing edges in the array, the last one
+ * flagged.  Each edge is
+ *
+ *   bits 0-5    the letter (A-Z as 0-25, a-z as 26-51)
+ *   bit 6       the letters up to and including this one are a word
+ *   bit 7       last edge of its node
+ *   bits 8-31   index of the first edge of the node it leads to,
+ *               0 for a node without edges
+ *
+ * Only letters can be stored, since philspel's words are runs of
+ * letters; dictionary words with anything else in them can never match
+ * and are left out.  The 24 bit edge indexes limit the graph to
+ * DAWG_MAX_EDGES edges.
+ *
+ * A lookup walks the graph one byte at a time with a cursor (the index
+ * of the last edge taken), so it can follow a word while the word is
+ * still being read.  Cursor DAWG_START is the empty prefix and
+ * DAWG_DEAD means no word starts this way.
+ */
+#define DAWG_MAX_EDGES (1U << 24)
+#define DAWG_DEAD 0
+#define DAWG_START 1
+
+#define DAWG_LETTER(edge) ((edge) & 0x3f)
+#define DAWG_FINAL(edge) (((edge) >> 6) & 1)
+#define DAWG_LAST(edge) (((edge) >> 7) & 1)
+#define DAWG_TARGET(edge) ((edge) >> 8)
+
+/*
+ * 64 for a byte that is not a letter, so it matches no edge.
+ */
+extern const unsigned char dawgLetterCodes[256];
+
+typedef struct Dawg {
+  uint32_t *edges;
+  uint32_t edgeCount;
+  uint32_t nodeCount;
+  uint32_t words;
+} Dawg;
+
+/*
+ * Builds the DAWG of the count words.  They do not have to be sorted or
+ * distinct, and they do not have to outlive it.  Returns NULL if the
+ * graph would need more than DAWG_MAX_EDGES edges.
+ */
+extern Dawg *createDawg(char **words, int count);
+
+/*
+ * The cursor after following the byte c from cursor.
+ */
+static inline uint32_t dawgStep(const Dawg *dawg, uint32_t cursor,
+                                unsigned char c) {
+  uint32_t letter = dawgLetterCodes[c];
+  uint32_t edge = DAWG_TARGET(dawg->edges[cursor]);
+  if (edge == 0) {
+    return DAWG_DEAD;
+  }
+  while (1) {
+    uint32_t value = dawg->edges[edge];
+    if (DAWG_LETTER(value) == letter) {
+      return edge;
+    }
+    if (DAWG_LAST(value)) {
+      return DAWG_DEAD;
+    }
+    edge++;
+  }
+}
+
+/*
+ * Nonzero if the bytes followed to reach cursor are a word.
+ */
+static inline int dawgIsWord(const Dawg *dawg, uint32_t cursor) {
+  return DAWG_FINAL(dawg->edges[cursor]);
+}
+
+/*
+ * Nonzero if the length bytes at word are a word of the DAWG.
+ */
+extern int dawgContains(const Dawg *dawg, const char *word, size_t length);
+
+extern size_t dawgBytes(const Dawg *dawg);
+
+extern void printDawgStats(const Dawg *dawg, FILE *out);
+
+extern void freeDawg(Dawg *dawg);
+
+#endif
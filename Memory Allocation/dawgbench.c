@@ -0,0 +1,225 @@
+/*
+ * Memory per word and lookup throughput of the DAWG against the chained
+ * HashTable philspel uses by default, on two generated word lists:
+ * random letters (no shared structure beyond chance prefixes) and
+ * "inflected" words, stems with a handful of common endings each, which
+ * is closer to a real language's word list.  A word list file can be
+ * given instead.
+ *
+ * The HashTable memory is its bucket array and nodes, then with the
+ * words themselves (their bytes and NULs, as when the dictionary file is
+ * mapped).  The DAWG has nothing besides its edges.
+ *
+ * usage: ./dawgbench [words] [lookups] [word list]
+ */
+#include "dawg.h"
+#include "hashtable.h"
+#include "wordhash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *endings[] = {"", "s", "ed", "ing", "er", "ers", "ly",
+                                "ness", "able", "ation"};
+
+#define ENDINGS (sizeof(endings) / sizeof(endings[0]))
+
+/*
+ * Same hash and strcmp equality that philspel uses.
+ */
+static unsigned int stringHash(void *s) {
+  return wordHash((char *)s, strlen((char *)s));
+}
+
+static int stringEquals(void *s1, void *s2) {
+  return strcmp((char *)s1, (char *)s2) == 0;
+}
+
+static unsigned long long rngState = 88172645463325252ULL;
+
+static unsigned long long nextRandom(void) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return rngState;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static char *randomLetters(int length, const char *ending) {
+  char *word = malloc(length + strlen(ending) + 1);
+  int i = 0;
+  for (i = 0; i < length; ++i) {
+    word[i] = 'a' + nextRandom() % 26;
+  }
+  strcpy(word + length, ending);
+  return word;
+}
+
+static char **randomWords(int count) {
+  char **words = malloc(sizeof(char *) * count);
+  int i = 0;
+  for (i = 0; i < count; ++i) {
+    words[i] = randomLetters(3 + nextRandom() % 10, "");
+  }
+  return words;
+}
+
+static char **inflectedWords(int count) {
+  char **words = malloc(sizeof(char *) * count);
+  char *stem = NULL;
+  int i = 0;
+  for (i = 0; i < count; ++i) {
+    if (i % ENDINGS == 0) {
+      free(stem);
+      stem = randomLetters(3 + nextRandom() % 6, "");
+    }
+    words[i] = malloc(strlen(stem) + strlen(endings[i % ENDINGS]) + 1);
+    strcpy(words[i], stem);
+    strcat(words[i], endings[i % ENDINGS]);
+  }
+  free(stem);
+  return words;
+}
+
+static char **readWords(const char *filename, int *count) {
+  FILE *in = fopen(filename, "r");
+  char word[1024];
+  char **words = NULL;
+  int capacity = 0;
+  if (in == NULL) {
+    perror(filename);
+    exit(1);
+  }
+  *count = 0;
+  while (fscanf(in, "%1023s", word) == 1) {
+    if (*count == capacity) {
+      capacity = 2 * capacity + 1024;
+      words = realloc(words, sizeof(char *) * capacity);
+    }
+    words[(*count)++] = strdup(word);
+  }
+  fclose(in);
+  return words;
+}
+
+static void compare(const char *name, char **words, int count, int lookups) {
+  HashTable *table = createHashTable(999, stringHash, stringEquals);
+  struct HashTableStats stats;
+  char **hits = malloc(sizeof(char *) * lookups);
+  char **misses = malloc(sizeof(char *) * lookups);
+  size_t *hitLengths = malloc(sizeof(size_t) * lookups);
+  size_t *missLengths = malloc(sizeof(size_t) * lookups);
+  double start, buildTable, buildDawg, tableHit, tableMiss, dawgHit, dawgMiss;
+  size_t wordBytes = 0;
+  long found = 0;
+  Dawg *dawg = NULL;
+  int i = 0;
+
+  // the misses are hits with their last letter changed, so they walk
+  // most of the way down the DAWG (a few of them are words after all)
+  for (i = 0; i < lookups; ++i) {
+    const char *word = words[nextRandom() % count];
+    hits[i] = strdup(word);
+    hitLengths[i] = strlen(word);
+    misses[i] = strdup(word);
+    missLengths[i] = hitLengths[i];
+    misses[i][missLengths[i] - 1] = 'A' + nextRandom() % 26;
+  }
+
+  start = now();
+  for (i = 0; i < count; ++i) {
+    insertData(table, words[i], words[i]);
+    wordBytes += strlen(words[i]) + 1;
+  }
+  buildTable = now() - start;
+  start = now();
+  dawg = createDawg(words, count);
+  buildDawg = now() - start;
+  if (dawg == NULL) {
+    fprintf(stderr, "%s: too many edges for a DAWG\n", name);
+    exit(1);
+  }
+  getHashTableStats(table, &stats);
+
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found += findData(table, hits[i]) != NULL;
+  }
+  tableHit = now() - start;
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found -= dawgContains(dawg, hits[i], hitLengths[i]);
+  }
+  dawgHit = now() - start;
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found += findData(table, misses[i]) != NULL;
+  }
+  tableMiss = now() - start;
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found -= dawgContains(dawg, misses[i], missLengths[i]);
+  }
+  dawgMiss = now() - start;
+  if (found != 0) {
+    fprintf(stderr, "%s: the table and the DAWG disagree\n", name);
+    exit(1);
+  }
+
+  printf("%s: %d words, %.1f letters per word, %u DAWG edges\n", name,
+         count, (double)wordBytes / count - 1, dawg->edgeCount);
+  printf("%-10s %12s %12s %10s %10s %10s\n", "", "bytes/word", "+ words",
+         "build ms", "hit ns", "miss ns");
+  printf("%-10s %12.1f %12.1f %10.1f %10.1f %10.1f\n", "hashtable",
+         (double)(stats.arrayBytes + stats.nodeBytes) / count,
+         (double)(stats.arrayBytes + stats.nodeBytes + wordBytes) / count,
+         buildTable / 1e6, tableHit / lookups, tableMiss / lookups);
+  printf("%-10s %12.1f %12.1f %10.1f %10.1f %10.1f\n\n", "dawg",
+         (double)dawgBytes(dawg) / count, (double)dawgBytes(dawg) / count,
+         buildDawg / 1e6, dawgHit / lookups, dawgMiss / lookups);
+
+  freeDawg(dawg);
+  freeTable(table);
+  for (i = 0; i < lookups; ++i) {
+    free(hits[i]);
+    free(misses[i]);
+  }
+  free(hits);
+  free(misses);
+  free(hitLengths);
+  free(missLengths);
+}
+
+static void freeWords(char **words, int count) {
+  int i = 0;
+  for (i = 0; i < count; ++i) {
+    free(words[i]);
+  }
+  free(words);
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 500000;
+  int lookups = argc > 2 ? atoi(argv[2]) : 2000000;
+  char **words = NULL;
+
+  if (argc > 3) {
+    words = readWords(argv[3], &count);
+    compare(argv[3], words, count, lookups);
+    freeWords(words, count);
+    return 0;
+  }
+  words = randomWords(count);
+  compare("random", words, count, lookups);
+  freeWords(words, count);
+  words = inflectedWords(count);
+  compare("inflected", words, count, lookups);
+  freeWords(words, count);
+  return 0;
+}
@@ -0,0 +1,294 @@
+#include "dictimage.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * How many keys findImageDataBatch has in flight at once.
+ */
+#define BATCH_WIDTH 16
+
+/*
+ * The same murmur3 finalizer the power of two hashtables use.  The
+ * image's hash function (philspel's stringHash, which is wordHash) is
+ * mixed again before its low bits pick the bucket, as the image does
+ * not trust the caller's hash to spread its bits.
+ */
+static unsigned int mixHash(unsigned int hash) {
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bU;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35U;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+int writeDictionaryImage(const char *filename, char **words, int count,
+                         unsigned int (*hashFunction)(void *)) {
+  struct ImageHeader header;
+  unsigned int *hashes = malloc(sizeof(unsigned int) * (count + 1));
+  uint32_t *bucketStart = NULL;
+  uint32_t *order = malloc(sizeof(uint32_t) * (count + 1));
+  struct ImageEntry *entries = malloc(sizeof(struct ImageEntry) * (count + 1));
+  char *strings = NULL;
+  size_t stringBytes = 0;
+  size_t stringsAt = 0;
+  uint32_t buckets = 1;
+  FILE *f = NULL;
+  int failed = 0;
+  int i = 0;
+
+  /*
+   * At most one word per bucket on average, like the chained table.
+   */
+  while (buckets < (uint32_t)count) {
+    buckets *= 2;
+  }
+  bucketStart = calloc(buckets + 1, sizeof(uint32_t));
+  for (i = 0; i < count; ++i) {
+    hashes[i] = (hashFunction)(words[i]);
+    bucketStart[mixHash(hashes[i]) & (buckets - 1)] += 1;
+    stringBytes += strlen(words[i]) + 1;
+  }
+
+  /*
+   * Sort the words by bucket (a counting sort): afterwards bucketStart[b]
+   * is where bucket b starts, and the words a lookup compares against
+   * sit next to each other.
+   */
+  for (i = 1; i <= (int)buckets; ++i) {
+    bucketStart[i] += bucketStart[i - 1];
+  }
+  for (i = count - 1; i >= 0; --i) {
+    order[--bucketStart[mixHash(hashes[i]) & (buckets - 1)]] = i;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, DICTIMAGE_MAGIC, sizeof(DICTIMAGE_MAGIC));
+  header.buckets = buckets;
+  header.words = count;
+  stringsAt = sizeof(header) + sizeof(uint32_t) * (buckets + 1) +
+              sizeof(struct ImageEntry) * count;
+  header.size = stringsAt + stringBytes;
+  if (header.size > UINT32_MAX) {
+    errno = EFBIG;
+    failed = 1;
+  }
+  else {
+    strings = malloc(stringBytes + 1);
+    stringBytes = 0;
+    for (i = 0; i < count; ++i) {
+      char *word = words[order[i]];
+      size_t length = strlen(word) + 1;
+      entries[i].hash = hashes[order[i]];
+      entries[i].offset = stringsAt + stringBytes;
+      memcpy(strings + stringBytes, word, length);
+      stringBytes += length;
+    }
+    f = fopen(filename, "wb");
+    failed = f == NULL;
+  }
+  if (!failed) {
+    failed = fwrite(&header, sizeof(header), 1, f) != 1 ||
+             fwrite(bucketStart, sizeof(uint32_t), buckets + 1, f) !=
+                 buckets + 1 ||
+             fwrite(entries, sizeof(struct ImageEntry), count, f) !=
+                 (size_t)count ||
+             fwrite(strings, sizeof(char), stringBytes, f) != stringBytes;
+    failed = fclose(f) != 0 || failed;
+  }
+
+  free(hashes);
+  free(bucketStart);
+  free(order);
+  free(entries);
+  free(strings);
+  return failed ? -1 : 0;
+}
+
+DictionaryImage *openDictionaryImage(const char *filename,
+                                     unsigned int (*hashFunction)(void *)) {
+  DictionaryImage *image = NULL;
+  const struct ImageHeader *header = NULL;
+  struct stat info;
+  void *base = NULL;
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(*header)) {
+    close(fd);
+    return NULL;
+  }
+  base = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+
+  /*
+   * Only the header and the last byte are checked, looking at more would
+   * page in the whole file.  The last byte has to be a NUL so that no
+   * string comparison can run off the end of the mapping.
+   */
+  header = base;
+  if (memcmp(header->magic, DICTIMAGE_MAGIC, sizeof(DICTIMAGE_MAGIC)) != 0 ||
+      header->size != (uint64_t)info.st_size || header->buckets == 0 ||
+      (header->buckets & (header->buckets - 1)) != 0 ||
+      sizeof(*header) + sizeof(uint32_t) * ((uint64_t)header->buckets + 1) +
+              sizeof(struct ImageEntry) * (uint64_t)header->words >
+          header->size ||
+      (header->words > 0 && ((char *)base)[info.st_size - 1] != '\0')) {
+    munmap(base, info.st_size);
+    return NULL;
+  }
+
+  image = malloc(sizeof(DictionaryImage));
+  image->hashFunction = hashFunction;
+  image->base = base;
+  image->size = info.st_size;
+  image->header = header;
+  image->bucketStart = (const uint32_t *)(header + 1);
+  image->entries =
+      (const struct ImageEntry *)(image->bucketStart + header->buckets + 1);
+  return image;
+}
+
+void closeDictionaryImage(DictionaryImage *image) {
+  munmap((void *)image->base, image->size);
+  free(image);
+}
+
+/*
+ * Compares key against the words of its bucket.
+ */
+static void *findImageHashed(DictionaryImage *image, void *key,
+                             unsigned int hash, uint32_t bucket) {
+  uint32_t at = image->bucketStart[bucket];
+  uint32_t end = image->bucketStart[bucket + 1];
+  for (; at < end; ++at) {
+    const struct ImageEntry *entry = &image->entries[at];
+    if (entry->hash == hash &&
+        strcmp((char *)key, image->base + entry->offset) == 0) {
+      return (void *)(image->base + entry->offset);
+    }
+  }
+  return NULL;
+}
+
+void *findImageData(DictionaryImage *image, void *key) {
+  return findImageDataHashed(image, key, (image->hashFunction)(key));
+}
+
+void *findImageDataHashed(DictionaryImage *image, void *key,
+                          unsigned int hash) {
+  return findImageHashed(image, key, hash,
+                         mixHash(hash) & (image->header->buckets - 1));
+}
+
+/*
+ * The same two passes as findDataBatch: hash every key of a group and
+ * prefetch its bucketStart, then prefetch the entries, then compare.
+ */
+void findImageDataBatch(DictionaryImage *image, void **keys, void **out,
+                        size_t n) {
+  unsigned int hashes[BATCH_WIDTH];
+  uint32_t bucketMask = image->header->buckets - 1;
+  uint32_t locations[BATCH_WIDTH];
+  size_t done = 0;
+  size_t width = 0;
+  size_t i = 0;
+  for (done = 0; done < n; done += width) {
+    width = n - done < BATCH_WIDTH ? n - done : BATCH_WIDTH;
+    for (i = 0; i < width; ++i) {
+      hashes[i] = (image->hashFunction)(keys[done + i]);
+      locations[i] = mixHash(hashes[i]) & bucketMask;
+      __builtin_prefetch(&image->bucketStart[locations[i]]);
+    }
+    for (i = 0; i < width; ++i) {
+      __builtin_prefetch(&image->entries[image->bucketStart[locations[i]]]);
+    }
+    for (i = 0; i < width; ++i) {
+      out[done + i] =
+          findImageHashed(image, keys[done + i], hashes[i], locations[i]);
+    }
+  }
+}
+
+void printDictionaryImageStats(DictionaryImage *image, FILE *out) {
+  fprintf(out, "dictionary image: %u words in %u buckets, load factor %.2f\n",
+          image->header->words, image->header->buckets,
+          (double)image->header->words / image->header->buckets);
+  fprintf(out, "memory: %zu bytes mapped, none allocated\n", image->size);
+}
+
+MappedWords *mapWordList(const char *filename) {
+  MappedWords *list = NULL;
+  struct stat info;
+  int capacity = 0;
+  size_t at = 0;
+  size_t start = 0;
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    close(fd);
+    return NULL;
+  }
+  list = calloc(1, sizeof(MappedWords));
+  list->size = info.st_size;
+  if (list->size > 0) {
+    list->base = mmap(NULL, list->size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+  }
+  close(fd);
+  if (list->base == MAP_FAILED) {
+    free(list);
+    return NULL;
+  }
+  madvise(list->base, list->size, MADV_SEQUENTIAL);
+
+  while (at < list->size) {
+    while (at < list->size && isspace((unsigned char)list->base[at])) {
+      ++at;
+    }
+    start = at;
+    while (at < list->size && !isspace((unsigned char)list->base[at])) {
+      ++at;
+    }
+    if (at == start) {
+      break;
+    }
+    if (list->count == capacity) {
+      capacity = 2 * capacity + 1024;
+      list->words = realloc(list->words, sizeof(char *) * capacity);
+    }
+    if (at < list->size) {
+      list->base[at++] = '\0';
+      list->words[list->count++] = list->base + start;
+    }
+    else {
+      list->lastWord = malloc(at - start + 1);
+      memcpy(list->lastWord, list->base + start, at - start);
+      list->lastWord[at - start] = '\0';
+      list->words[list->count++] = list->lastWord;
+    }
+  }
+  return list;
+}
+
+void unmapWordList(MappedWords *list) {
+  if (list->base != NULL) {
+    munmap(list->base, list->size);
+  }
+  free(list->words);
+  free(list->lastWord);
+  free(list);
+}
@@ -0,0 +1,118 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _DICTIMAGE_H_
+#define _DICTIMAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A prebuilt dictionary: a set of strings already laid out as a hash
+ * table in a file, so it can be mmap()ed read only and searched in place
+ * with no parsing and no allocation.
+ *
+ * Everything in the file is addressed by offsets from its start, so it
+ * does not matter where it gets mapped.  The layout is
+ *
+ *   struct ImageHeader
+ *   uint32_t bucketStart[buckets + 1]   entries of bucket b are
+ *                                       bucketStart[b] .. bucketStart[b+1]
+ *   struct ImageEntry entries[words]
+ *   the words, NUL terminated, in bucket order
+ *
+ * The numbers are in the byte order of the machine that wrote the file,
+ * and the bucket of a word depends on the hash function, so an image has
+ * to be opened with the same hashFunction it was written with.  (The
+ * magic went to 2 when philspel's stringHash stopped being djb2, so its
+ * older images are refused instead of silently missing every word.)
+ */
+#define DICTIMAGE_MAGIC "PSDICT2"
+
+struct ImageHeader {
+  char magic[8];
+  uint32_t buckets;
+  uint32_t words;
+  uint64_t size;
+};
+
+struct ImageEntry {
+  uint32_t hash;
+  uint32_t offset;
+};
+
+typedef struct DictionaryImage {
+  unsigned int (*hashFunction)(void *);
+  const char *base;
+  size_t size;
+  const struct ImageHeader *header;
+  const uint32_t *bucketStart;
+  const struct ImageEntry *entries;
+} DictionaryImage;
+
+/*
+ * Writes the count words to filename as an image.  Returns 0, or -1 with
+ * errno set if the file could not be written.
+ */
+extern int writeDictionaryImage(const char *filename, char **words, int count,
+                                unsigned int (*hashFunction)(void *));
+
+/*
+ * Maps filename.  Returns NULL if it can not be opened or is not an
+ * image.
+ */
+extern DictionaryImage *openDictionaryImage(
+    const char *filename, unsigned int (*hashFunction)(void *));
+
+/*
+ * Returns the image's copy of key, or NULL if key is not in it.  Like
+ * findData on a table whose data are its keys.
+ */
+extern void *findImageData(DictionaryImage *image, void *key);
+
+/*
+ * findImageData for a key whose hash(Function) the caller already has.
+ */
+extern void *findImageDataHashed(DictionaryImage *image, void *key,
+                                 unsigned int hash);
+
+/*
+ * findImageData for n keys at once, with the memory accesses of
+ * neighbouring keys overlapped like findDataBatch.
+ */
+extern void findImageDataBatch(DictionaryImage *image, void **keys,
+                               void **out, size_t n);
+
+extern void printDictionaryImageStats(DictionaryImage *image, FILE *out);
+
+extern void closeDictionaryImage(DictionaryImage *image);
+
+/*
+ * A word list (words separated by whitespace, as readDictionary reads
+ * them with fscanf) used in place: the file is mapped privately and the
+ * whitespace after each word is overwritten with a terminator, so words
+ * points straight into the mapping.  Every page holds a terminator, so
+ * the private mapping ends up copied in full, but in one pass and with
+ * nothing allocated per word.  If the file does not end in whitespace
+ * there is no room for the last word's terminator, and lastWord is a
+ * copy of it instead.
+ */
+typedef struct MappedWords {
+  char *base;
+  size_t size;
+  char **words;
+  int count;
+  char *lastWord;
+} MappedWords;
+
+/*
+ * Returns NULL if filename can not be mapped (it does not exist, or is
+ * not a regular file).
+ */
+extern MappedWords *mapWordList(const char *filename);
+
+extern void unmapWordList(MappedWords *list);
+
+#endif
@@ -0,0 +1,564 @@
+/*
+ * Lookup heavy microbenchmark comparing the hashtable backends side by
+ * side on the same random dictionary style string keys, followed by the
+ * per insert latency distribution of each backend (where the resizes
+ * show up).
+ *
+ * usage: ./hashbench [keys] [lookups]
+ */
+#include "bloom.h"
+#include "hashtable.h"
+#include "perfecthash.h"
+#include "typedtable.h"
+#include "wordhash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+struct Backend {
+  const char *name;
+  int flags;
+};
+
+static struct Backend backends[] = {
+  {"chained", 0},
+  {"open", HASHTABLE_OPEN_ADDRESSING},
+  {"incremental", HASHTABLE_INCREMENTAL},
+  {"pow2", HASHTABLE_POW2},
+  {"inline keys", HASHTABLE_INLINE_KEYS},
+};
+
+#define BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+/*
+ * The latency histogram has one bin per power of two nanoseconds.
+ */
+#define HISTOGRAM_BINS 32
+
+/*
+ * Same hash and strcmp equality that philspel uses.
+ */
+static unsigned int stringHash(void *s) {
+  return wordHash((char *)s, strlen((char *)s));
+}
+
+static int stringEquals(void *s1, void *s2) {
+  return strcmp((char *)s1, (char *)s2) == 0;
+}
+
+static unsigned long long rngState = 88172645463325252ULL;
+
+static unsigned long long nextRandom(void) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return rngState;
+}
+
+/*
+ * A lowercase word of 3 to 12 letters, prefixed by prefix (which keeps
+ * the miss keys disjoint from the hit keys).
+ */
+static char *randomWord(char prefix) {
+  int length = 3 + nextRandom() % 10;
+  char *word = malloc(length + 2);
+  int i = 0;
+  word[0] = prefix;
+  for (i = 1; i <= length; ++i) {
+    word[i] = 'a' + nextRandom() % 26;
+  }
+  word[length + 1] = '\0';
+  return word;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Times every insertData separately, then prints the percentiles and
+ * fills in histogram (counts per power of two nanoseconds).
+ */
+static void measureLatency(struct Backend *backend, char **words, int keys,
+                           double *latency, long *histogram) {
+  HashTable *table = createHashTableWithFlags(999, stringHash, stringEquals,
+                                              backend->flags);
+  int i = 0;
+  for (i = 0; i < keys; ++i) {
+    double start = now();
+    int bin = 0;
+    insertData(table, words[i], words[i]);
+    latency[i] = now() - start;
+    while (bin < HISTOGRAM_BINS - 1 && latency[i] >= (double)(2L << bin)) {
+      bin++;
+    }
+    histogram[bin]++;
+  }
+  freeTable(table);
+  qsort(latency, keys, sizeof(double), compareDoubles);
+  printf("%-12s %10.0f %10.0f %10.0f %10.0f %12.0f\n", backend->name,
+         latency[keys / 2], latency[(long)keys * 99 / 100],
+         latency[(long)keys * 999 / 1000], latency[(long)keys * 9999 / 10000],
+         latency[keys - 1]);
+}
+
+DEFINE_TYPED_HASHTABLE(IntTable, int64_t, int64_t, typedIntHash, typedIntEqual)
+DEFINE_TYPED_HASHTABLE(StringTable, const char *, const char *,
+                       typedStringHash, typedStringEqual)
+
+static unsigned int intHash(void *i) {
+  return (unsigned int)(uintptr_t)i;
+}
+
+static int intEquals(void *i, void *j) {
+  return i == j;
+}
+
+/*
+ * Hit lookups through the generic chained table (two indirect calls per
+ * probe) next to the same keys in the compile time specialized tables.
+ */
+static void compareSpecialized(char **words, int keys, void **hitKeys,
+                               int lookups) {
+  HashTable *generic = createHashTable(999, stringHash, stringEquals);
+  StringTable *strings = createStringTable(999);
+  IntTable *ints = createIntTable(999);
+  int64_t *intKeys = malloc(sizeof(int64_t) * keys);
+  int64_t *intLookups = malloc(sizeof(int64_t) * lookups);
+  double start, genericTime, typedTime;
+  long found = 0;
+  int i = 0;
+
+  printf("\n%-12s %12s %12s\n", "hit ns/op", "generic", "typed");
+  for (i = 0; i < keys; ++i) {
+    insertData(generic, words[i], words[i]);
+    insertStringTable(strings, words[i], words[i]);
+  }
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found += findData(generic, hitKeys[i]) != NULL;
+  }
+  genericTime = now() - start;
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found -= findStringTable(strings, hitKeys[i]) != NULL;
+  }
+  typedTime = now() - start;
+  printf("%-12s %12.1f %12.1f\n", "strings", genericTime / lookups,
+         typedTime / lookups);
+  freeTable(generic);
+
+  /*
+   * Random integers looked up in random order, so neither table gets the
+   * cache friendly layout that consecutive keys would give the % table.
+   */
+  for (i = 0; i < keys; ++i) {
+    intKeys[i] = nextRandom() >> 1;
+  }
+  for (i = 0; i < lookups; ++i) {
+    intLookups[i] = intKeys[nextRandom() % keys];
+  }
+  generic = createHashTable(999, intHash, intEquals);
+  for (i = 0; i < keys; ++i) {
+    insertData(generic, (void *)(intptr_t)intKeys[i], words[i]);
+    insertIntTable(ints, intKeys[i], i);
+  }
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found += findData(generic, (void *)(intptr_t)intLookups[i]) != NULL;
+  }
+  genericTime = now() - start;
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found -= findIntTable(ints, intLookups[i]) != NULL;
+  }
+  typedTime = now() - start;
+  printf("%-12s %12.1f %12.1f\n", "ints", genericTime / lookups,
+         typedTime / lookups);
+
+  if (found != 0) {
+    fprintf(stderr, "generic and typed tables disagree\n");
+    exit(1);
+  }
+  freeTable(generic);
+  freeStringTable(strings);
+  freeIntTable(ints);
+  free(intKeys);
+  free(intLookups);
+}
+
+/*
+ * The chained table next to the minimal perfect hash table built over
+ * the same keys: memory per key (without the keys themselves) and hit
+ * and miss ns/op.
+ */
+static void comparePerfect(char **words, int keys, void **hitKeys,
+                           void **missKeys, int lookups) {
+  HashTable *chained = createHashTable(999, stringHash, stringEquals);
+  PerfectHashTable *perfect = NULL;
+  struct HashTableStats stats;
+  double start, buildTime, chainedHit, chainedMiss, perfectHit, perfectMiss;
+  long found = 0;
+  int i = 0;
+
+  for (i = 0; i < keys; ++i) {
+    insertData(chained, words[i], words[i]);
+  }
+  getHashTableStats(chained, &stats);
+  start = now();
+  perfect = createPerfectHashTable(words, (void **)words, keys);
+  buildTime = now() - start;
+  if (perfect == NULL) {
+    fprintf(stderr, "no perfect hash for the keys\n");
+    exit(1);
+  }
+
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found += findData(chained, hitKeys[i]) != NULL;
+  }
+  chainedHit = now() - start;
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found += findData(chained, missKeys[i]) != NULL;
+  }
+  chainedMiss = now() - start;
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found -= findPerfectData(perfect, hitKeys[i]) != NULL;
+  }
+  perfectHit = now() - start;
+  start = now();
+  for (i = 0; i < lookups; ++i) {
+    found -= findPerfectData(perfect, missKeys[i]) != NULL;
+  }
+  perfectMiss = now() - start;
+  if (found != 0) {
+    fprintf(stderr, "chained and perfect tables disagree\n");
+    exit(1);
+  }
+
+  printf("\n%-12s %12s %10s %10s\n", "", "bytes/key", "hit", "miss");
+  printf("%-12s %12.1f %10.1f %10.1f\n", "chained",
+         (double)(stats.arrayBytes + stats.nodeBytes) / keys,
+         chainedHit / lookups, chainedMiss / lookups);
+  printf("%-12s %12.1f %10.1f %10.1f\n", "perfect",
+         (double)perfectHashBytes(perfect) / keys, perfectHit / lookups,
+         perfectMiss / lookups);
+  printf("building the perfect hash took %.1f ms\n", buildTime / 1e6);
+  freeTable(chained);
+  freePerfectHashTable(perfect);
+}
+
+/*
+ * Lookups in the chained table with a blocked Bloom filter in front, for
+ * a few false positive rates: the rate asked for, the rate measured on
+ * the miss keys, and hit and miss ns/op (hashing for the filter and, if
+ * it lets the key through, the findData).
+ */
+static void compareBloom(char **words, int keys, void **hitKeys,
+                         void **missKeys, int lookups) {
+  static double rates[] = {0, 0.1, 0.01, 0.001};
+  HashTable *table = createHashTable(999, stringHash, stringEquals);
+  size_t r = 0;
+  int i = 0;
+
+  for (i = 0; i < keys; ++i) {
+    insertData(table, words[i], words[i]);
+  }
+  printf("\n%-12s %10s %10s %10s %10s\n", "bloom fpr", "bits/key",
+         "measured", "hit", "miss");
+  for (r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r) {
+    BloomFilter *filter = NULL;
+    double start, hitTime, missTime;
+    long found = 0;
+    long passed = 0;
+    if (rates[r] > 0) {
+      filter = createBloomFilter(keys, rates[r]);
+      for (i = 0; i < keys; ++i) {
+        addToBloomFilter(filter, stringHash(words[i]));
+      }
+    }
+
+    start = now();
+    for (i = 0; i < lookups; ++i) {
+      if (filter == NULL || bloomFilterMayContain(filter, stringHash(hitKeys[i]))) {
+        found += findData(table, hitKeys[i]) != NULL;
+      }
+    }
+    hitTime = now() - start;
+    start = now();
+    for (i = 0; i < lookups; ++i) {
+      if (filter == NULL || bloomFilterMayContain(filter, stringHash(missKeys[i]))) {
+        passed += 1;
+        found -= findData(table, missKeys[i]) != NULL;
+      }
+    }
+    missTime = now() - start;
+    if (found != lookups) {
+      fprintf(stderr, "the bloom filter lost keys\n");
+      exit(1);
+    }
+
+    if (filter == NULL) {
+      printf("%-12s %10s %10s %10.1f %10.1f\n", "none", "-", "-",
+             hitTime / lookups, missTime / lookups);
+    }
+    else {
+      printf("%-12g %10.1f %10.4f %10.1f %10.1f\n", rates[r],
+             8.0 * bloomFilterBytes(filter) / keys, (double)passed / lookups,
+             hitTime / lookups, missTime / lookups);
+      freeBloomFilter(filter);
+    }
+  }
+  freeTable(table);
+}
+
+/*
+ * The chained table with its keys behind the bucket's key pointer and
+ * with HASHTABLE_INLINE_KEYS.  The hits are looked up with copies of the
+ * keys: the other hit columns look up the very strings that were
+ * inserted, which the lookup has already read by the time it compares.
+ * Memory per key is the table's, then with the key strings it points to
+ * (all of them for the pointer layout, only the long ones with inline
+ * keys).
+ */
+static void compareInlineKeys(char **words, int keys, void **missKeys,
+                              int lookups) {
+  static const char *names[] = {"key pointer", "inline keys"};
+  static int flags[] = {0, HASHTABLE_INLINE_KEYS};
+  char **copies = malloc(sizeof(char *) * keys);
+  void **hitKeys = malloc(sizeof(void *) * lookups);
+  size_t keyBytes = 0;
+  size_t longKeyBytes = 0;
+  int t = 0;
+  int i = 0;
+
+  for (i = 0; i < keys; ++i) {
+    size_t length = strlen(words[i]);
+    copies[i] = strdup(words[i]);
+    keyBytes += length + 1;
+    if (length >= HASHTABLE_INLINE_KEY) {
+      longKeyBytes += length + 1;
+    }
+  }
+  for (i = 0; i < lookups; ++i) {
+    hitKeys[i] = copies[nextRandom() % keys];
+  }
+
+  printf("\n%-12s %12s %12s %10s %10s\n", "", "bytes/key", "+ keys", "hit",
+         "miss");
+  for (t = 0; t < 2; ++t) {
+    HashTable *table =
+        createHashTableWithFlags(999, stringHash, stringEquals, flags[t]);
+    struct HashTableStats stats;
+    double start, hitTime, missTime;
+    long found = 0;
+
+    for (i = 0; i < keys; ++i) {
+      insertData(table, words[i], words[i]);
+    }
+    getHashTableStats(table, &stats);
+    start = now();
+    for (i = 0; i < lookups; ++i) {
+      found += findData(table, hitKeys[i]) != NULL;
+    }
+    hitTime = now() - start;
+    start = now();
+    for (i = 0; i < lookups; ++i) {
+      found += findData(table, missKeys[i]) != NULL;
+    }
+    missTime = now() - start;
+    if (found != lookups) {
+      fprintf(stderr, "%s: lost keys\n", names[t]);
+      exit(1);
+    }
+    printf("%-12s %12.1f %12.1f %10.1f %10.1f\n", names[t],
+           (double)(stats.arrayBytes + stats.nodeBytes) / keys,
+           (double)(stats.arrayBytes + stats.nodeBytes +
+                    (t == 0 ? keyBytes : longKeyBytes)) / keys,
+           hitTime / lookups, missTime / lookups);
+    freeTable(table);
+  }
+
+  for (i = 0; i < keys; ++i) {
+    free(copies[i]);
+  }
+  free(copies);
+  free(hitKeys);
+}
+
+/*
+ * Building the chained table by inserting the keys one at a time (from
+ * the usual 999 buckets, doubling as it goes) against buildHashTable on
+ * 1 to 8 threads, in ns per key.  The tables have to agree.
+ */
+static void compareBuild(char **words, int keys, void **hitKeys,
+                         int lookups) {
+  static int threads[] = {1, 2, 4, 8};
+  HashTable *inserted = createHashTable(999, stringHash, stringEquals);
+  double start, insertTime;
+  size_t t = 0;
+  int i = 0;
+
+  start = now();
+  for (i = 0; i < keys; ++i) {
+    insertData(inserted, words[i], words[i]);
+  }
+  insertTime = now() - start;
+
+  printf("\n%-12s %10s %10s\n", "build", "threads", "ns/key");
+  printf("%-12s %10d %10.1f\n", "insertData", 1, insertTime / keys);
+  for (t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+    HashTable *built = NULL;
+    double buildTime;
+    start = now();
+    built = buildHashTable((void **)words, (void **)words, keys, stringHash,
+                           stringEquals, 0, threads[t]);
+    buildTime = now() - start;
+    for (i = 0; i < lookups; i += 97) {
+      // (duplicate keys may give either copy, so only compare found)
+      if ((findData(built, hitKeys[i]) == NULL) !=
+          (findData(inserted, hitKeys[i]) == NULL) ||
+          findData(built, hitKeys[i]) == NULL) {
+        fprintf(stderr, "built and inserted tables disagree\n");
+        exit(1);
+      }
+    }
+    printf("%-12s %10d %10.1f\n", "buildHash", threads[t], buildTime / keys);
+    freeTable(built);
+  }
+  freeTable(inserted);
+}
+
+int main(int argc, char **argv) {
+  int keys = argc > 1 ? atoi(argv[1]) : 500000;
+  int lookups = argc > 2 ? atoi(argv[2]) : 4000000;
+  char **hits = malloc(sizeof(char *) * keys);
+  char **misses = malloc(sizeof(char *) * keys);
+  void **hitKeys = malloc(sizeof(void *) * lookups);
+  void **missKeys = malloc(sizeof(void *) * lookups);
+  void **results = malloc(sizeof(void *) * lookups);
+  double *latency = malloc(sizeof(double) * keys);
+  long histogram[BACKENDS][HISTOGRAM_BINS] = {{0}};
+  size_t b = 0;
+  int i = 0;
+
+  for (i = 0; i < keys; ++i) {
+    hits[i] = randomWord('h');
+    misses[i] = randomWord('m');
+  }
+  for (i = 0; i < lookups; ++i) {
+    int at = nextRandom() % keys;
+    hitKeys[i] = hits[at];
+    missKeys[i] = misses[at];
+  }
+
+  /*
+   * All lookup columns are ns/op; the batch ones go through findDataBatch.
+   */
+  printf("%-12s %10s %10s %10s %10s %10s %10s\n", "backend", "keys", "insert",
+         "hit", "miss", "batch hit", "batch miss");
+  for (b = 0; b < BACKENDS; ++b) {
+    HashTable *table = createHashTableWithFlags(999, stringHash, stringEquals,
+                                                backends[b].flags);
+    double start, insertTime, hitTime, missTime, batchHitTime, batchMissTime;
+    long found = 0;
+
+    start = now();
+    for (i = 0; i < keys; ++i) {
+      insertData(table, hits[i], hits[i]);
+    }
+    insertTime = now() - start;
+
+    start = now();
+    for (i = 0; i < lookups; ++i) {
+      found += findData(table, hitKeys[i]) != NULL;
+    }
+    hitTime = now() - start;
+
+    start = now();
+    for (i = 0; i < lookups; ++i) {
+      found += findData(table, missKeys[i]) != NULL;
+    }
+    missTime = now() - start;
+
+    start = now();
+    findDataBatch(table, hitKeys, results, lookups);
+    batchHitTime = now() - start;
+    for (i = 0; i < lookups; ++i) {
+      found -= results[i] != NULL;
+    }
+
+    start = now();
+    findDataBatch(table, missKeys, results, lookups);
+    batchMissTime = now() - start;
+    for (i = 0; i < lookups; ++i) {
+      found += results[i] != NULL;
+    }
+
+    if (found != 0) {
+      fprintf(stderr, "%s: single and batched lookups disagree\n",
+              backends[b].name);
+      return 1;
+    }
+    printf("%-12s %10d %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+           backends[b].name, keys, insertTime / keys, hitTime / lookups,
+           missTime / lookups, batchHitTime / lookups,
+           batchMissTime / lookups);
+    freeTable(table);
+  }
+
+  compareSpecialized(hits, keys, hitKeys, lookups);
+  comparePerfect(hits, keys, hitKeys, missKeys, lookups);
+  compareBloom(hits, keys, hitKeys, missKeys, lookups);
+  compareInlineKeys(hits, keys, missKeys, lookups);
+  compareBuild(hits, keys, hitKeys, lookups);
+
+  printf("\n%-12s %10s %10s %10s %10s %12s\n", "insert ns", "p50", "p99",
+         "p99.9", "p99.99", "max");
+  for (b = 0; b < BACKENDS; ++b) {
+    measureLatency(&backends[b], hits, keys, latency, histogram[b]);
+  }
+  printf("\n%-12s", "insert ns <");
+  for (b = 0; b < BACKENDS; ++b) {
+    printf(" %12s", backends[b].name);
+  }
+  printf("\n");
+  for (i = 0; i < HISTOGRAM_BINS; ++i) {
+    long total = 0;
+    for (b = 0; b < BACKENDS; ++b) {
+      total += histogram[b][i];
+    }
+    if (total == 0) {
+      continue;
+    }
+    printf("%-12ld", 2L << i);
+    for (b = 0; b < BACKENDS; ++b) {
+      printf(" %12ld", histogram[b][i]);
+    }
+    printf("\n");
+  }
+
+  for (i = 0; i < keys; ++i) {
+    free(hits[i]);
+    free(misses[i]);
+  }
+  free(hits);
+  free(misses);
+  free(hitKeys);
+  free(missKeys);
+  free(results);
+  free(latency);
+  return 0;
+}
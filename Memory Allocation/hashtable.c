@@ -2,84 +2,842 @@
 #include "hashtable.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * The open addressing backend keeps one control byte per slot.  A control
+ * byte is either CONTROL_EMPTY or the low 7 bits of the slot's hash, so a
+ * group of 16 control bytes can be compared against a tag in one step.
+ */
+#define GROUP_WIDTH 16
+#define CONTROL_EMPTY ((signed char)-128)
+
+/*
+ * How many old buckets an incremental resize moves per insertData or
+ * findData.  Anything from one up finishes the move before the new array
+ * fills up; each moved bucket costs a few cache misses, so keep it small.
+ */
+#define REHASH_STEP 2
+
+/*
+ * How many keys findDataBatch has in flight at once.
+ */
+#define BATCH_WIDTH 16
+
+/*
+ * The fewest keys buildHashTable gives a thread; with less than that the
+ * thread costs more to start than it saves.
+ */
+#define BUILD_KEYS_PER_THREAD 32768
+
+/*
+ * STATS(statement) only runs statement when built with -DHASHTABLE_STATS,
+ * otherwise the counting is not compiled in at all.
+ */
+#ifdef HASHTABLE_STATS
+#define STATS(statement) statement
+
+static double statsClock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Lookups only read the table, so threads may share one; the counters
+ * are updated atomically (relaxed, they are only statistics) to keep
+ * that true with HASHTABLE_STATS.
+ */
+static void countMax(int *max, int probes) {
+  int seen = __atomic_load_n(max, __ATOMIC_RELAXED);
+  while (probes > seen &&
+         !__atomic_compare_exchange_n(max, &seen, probes, 1, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+  }
+}
+
+static void countLookup(HashTable *table, int found, int probes) {
+  struct HashTableCounters *counters = &table->counters;
+  if (found) {
+    __atomic_fetch_add(&counters->hits, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->hitProbes, probes, __ATOMIC_RELAXED);
+    countMax(&counters->maxHitProbes, probes);
+  }
+  else {
+    __atomic_fetch_add(&counters->misses, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->missProbes, probes, __ATOMIC_RELAXED);
+    countMax(&counters->maxMissProbes, probes);
+  }
+}
+#else
+#define STATS(statement)
+#endif
+
+/*
+ * The user hash functions are not required to spread their bits (djb2
+ * leaves the low bits poorly mixed for short keys), and both the open
+ * table and HASHTABLE_POW2 only look at some of the bits, so they run
+ * the hash through the murmur3 32 bit finalizer first.
+ */
+static unsigned int mixHash(unsigned int hash) {
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bU;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35U;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+/*
+ * The chain a hash belongs to in an array of size buckets.
+ */
+static unsigned int bucketIndex(HashTable *table, unsigned int hash,
+                                int size) {
+  if (table->flags & HASHTABLE_POW2) {
+    return mixHash(hash) & (size - 1);
+  }
+  return hash % size;
+}
+
+static void createOpenTable(HashTable *table, int size);
+static void insertOpen(HashTable *table, void *key, void *data);
+static void *findOpen(HashTable *table, void *key);
+static void *findOpenHashed(HashTable *table, void *key, unsigned int hash);
+static void findOpenBatch(HashTable *table, void **keys,
+                          const unsigned int *keyHashes, void **out,
+                          size_t n);
+static struct HashBucket *findChain(HashTable *table, void *key,
+                                    unsigned int hash,
+                                    struct HashBucket *lookAt, int *probes);
+static void startRehash(HashTable *table);
+static void rehashStep(HashTable *table, int buckets);
 
 HashTable *createHashTable(int size, unsigned int (*hashFunction)(void *),
                            int (*equalFunction)(void *, void *)) {
+  return createHashTableWithFlags(size, hashFunction, equalFunction, 0);
+}
+
+HashTable *createHashTableWithFlags(int size,
+                                    unsigned int (*hashFunction)(void *),
+                                    int (*equalFunction)(void *, void *),
+                                    int flags) {
   int i = 0;
   HashTable *newTable = malloc(sizeof(HashTable));
   newTable->size = size;
   newTable->used = 0;
+  newTable->flags = flags;
+  newTable->data = NULL;
+  newTable->control = NULL;
+  newTable->slots = NULL;
+  newTable->oldData = NULL;
+  newTable->oldSize = 0;
+  newTable->rehashIndex = 0;
+  memset(&newTable->counters, 0, sizeof(newTable->counters));
+  newTable->hashFunction = hashFunction;
+  newTable->equalFunction = equalFunction;
+  initSlabPool(&newTable->buckets,
+               sizeof(struct HashBucket) +
+                   (flags & HASHTABLE_INLINE_KEYS ? HASHTABLE_INLINE_KEY : 0));
+  if (flags & HASHTABLE_OPEN_ADDRESSING) {
+    createOpenTable(newTable, size);
+    return newTable;
+  }
+  if (flags & HASHTABLE_POW2) {
+    newTable->size = 1;
+    while (newTable->size < size) {
+      newTable->size *= 2;
+    }
+    size = newTable->size;
+  }
   newTable->data = malloc(sizeof(struct HashBucket *) * size);
   for (i = 0; i < size; ++i) {
     newTable->data[i] = NULL;
   }
-  newTable->hashFunction = hashFunction;
-  newTable->equalFunction = equalFunction;
   return newTable;
 }
 
 void freeTable(HashTable *table){
-  int i = 0;
-  for(i = 0; i < table->size; ++i){
-    struct HashBucket *at = table->data[i];
-    struct HashBucket *old = NULL;
-    while(at != NULL){
-      old = at;
-      at = at->next;
-      free(old);
-    }
+  if (table->flags & HASHTABLE_OPEN_ADDRESSING) {
+    free(table->control);
+    free(table->slots);
+    free(table);
+    return;
   }
+  /*
+   * The buckets all live in the table's slabs, so there are no chains
+   * to walk.
+   */
+  freeSlabPool(&table->buckets);
+  free(table->oldData);
   free(table->data);
   free(table);
 }
 
+/*
+ * Everything of a new bucket but its place in a chain.
+ */
+static void fillBucket(HashTable *table, struct HashBucket *bucket,
+                       void *key, void *data, unsigned int hash) {
+  bucket->data = data;
+  bucket->key = key;
+  bucket->hash = hash;
+  if (table->flags & HASHTABLE_INLINE_KEYS) {
+    bucket->length = strlen((char *)key);
+    if (bucket->length < HASHTABLE_INLINE_KEY) {
+      memcpy(bucket->inlineKey, key, bucket->length + 1);
+      bucket->key = bucket->inlineKey;
+    }
+  }
+}
+
 void insertData(HashTable *table, void *key, void *data) {
   unsigned int location  = 0;
-  struct HashBucket *newBucket =
-      (struct HashBucket *)malloc(sizeof(struct HashBucket));
+  unsigned int hash = 0;
+  struct HashBucket *newBucket = NULL;
+  if (table->flags & HASHTABLE_OPEN_ADDRESSING) {
+    insertOpen(table, key, data);
+    return;
+  }
   /*
    * At this point we need to resize the table as the occupancy is too
-   * high.
+   * high.  The existing buckets are relinked into the new array rather
+   * than reallocated.
    */
-  if(table->used > table->size) {
+  if (table->oldData != NULL) {
+    rehashStep(table, REHASH_STEP);
+  }
+  if (table->used > table->size && (table->flags & HASHTABLE_INCREMENTAL)) {
+    startRehash(table);
+  }
+  else if(table->used > table->size) {
     int oldSize = table->size;
     struct HashBucket **oldData = table->data;
     int i = 0;
+    STATS(double start = statsClock());
     table->size = table->size * 2;
-    table->used = 0;
     table->data = malloc(sizeof(struct HashBucket *) * table->size);
     for(i = 0; i < table->size; ++i){
       table->data[i] = NULL;
     }
     for(i = 0; i < oldSize; ++i){
       struct HashBucket *at = oldData[i];
-      struct HashBucket *old = NULL;
+      struct HashBucket *next = NULL;
       while(at != NULL) {
-	insertData(table, at->key, at->data);
-	old = at;
-	at = at->next;
-	free(old);
+	next = at->next;
+	location = bucketIndex(table, at->hash, table->size);
+	at->next = table->data[location];
+	table->data[location] = at;
+	at = next;
       }
     }
     free(oldData);
-
+    STATS(table->counters.resizes += 1);
+    STATS(table->counters.resizeSeconds += statsClock() - start);
   }
-  location  = ((table->hashFunction)(key)) % table->size;
+  newBucket = (struct HashBucket *)slabAlloc(&table->buckets);
+  hash = (table->hashFunction)(key);
+  location  = bucketIndex(table, hash, table->size);
+  fillBucket(table, newBucket, key, data, hash);
   newBucket->next = table->data[location];
-  newBucket->data = data;
-  newBucket->key = key;
   table->data[location] = newBucket;
   table->used += 1;
 }
 
+/*
+ * One thread's share of buildHashTable: the keys [firstKey, lastKey) to
+ * hash and fill in buckets for, then the chains [firstChain, lastChain)
+ * to link them into.
+ */
+struct BuildPart {
+  HashTable *table;
+  void **keys;
+  void **data;
+  int count;
+  char *buckets;
+  unsigned int *locations;
+  int firstKey;
+  int lastKey;
+  unsigned int firstChain;
+  unsigned int lastChain;
+};
+
+static void *fillPart(void *p) {
+  struct BuildPart *part = p;
+  HashTable *table = part->table;
+  int i = 0;
+  for (i = part->firstKey; i < part->lastKey; ++i) {
+    struct HashBucket *bucket = (struct HashBucket *)(
+        part->buckets + (size_t)i * table->buckets.objectSize);
+    unsigned int hash = (table->hashFunction)(part->keys[i]);
+    part->locations[i] = bucketIndex(table, hash, table->size);
+    fillBucket(table, bucket, part->keys[i], part->data[i], hash);
+  }
+  return NULL;
+}
+
+/*
+ * Every thread reads all the locations but only links the buckets of its
+ * own chains, in key order, so the chains come out as if the keys had
+ * been inserted one after another.
+ */
+static void *linkPart(void *p) {
+  struct BuildPart *part = p;
+  HashTable *table = part->table;
+  int i = 0;
+  for (i = 0; i < part->count; ++i) {
+    unsigned int location = part->locations[i];
+    struct HashBucket *bucket = NULL;
+    if (location < part->firstChain || location >= part->lastChain) {
+      continue;
+    }
+    bucket = (struct HashBucket *)(part->buckets +
+                                   (size_t)i * table->buckets.objectSize);
+    bucket->next = table->data[location];
+    table->data[location] = bucket;
+  }
+  return NULL;
+}
+
+/*
+ * Runs work on every part, the first one on the calling thread.  A part
+ * whose thread cannot be created runs on the calling thread as well, as
+ * the parts do not depend on each other.
+ */
+static void runParts(void *(*work)(void *), struct BuildPart *parts,
+                     int threads) {
+  pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+  char *started = calloc(threads, 1);
+  int t = 0;
+  for (t = 1; t < threads; ++t) {
+    started[t] = pthread_create(&workers[t], NULL, work, &parts[t]) == 0;
+  }
+  work(&parts[0]);
+  for (t = 1; t < threads; ++t) {
+    if (started[t]) {
+      pthread_join(workers[t], NULL);
+    } else {
+      work(&parts[t]);
+    }
+  }
+  free(started);
+  free(workers);
+}
+
+HashTable *buildHashTable(void **keys, void **data, int count,
+                          unsigned int (*hashFunction)(void *),
+                          int (*equalFunction)(void *, void *), int flags,
+                          int threads) {
+  HashTable *table = NULL;
+  struct BuildPart *parts = NULL;
+  unsigned int *locations = NULL;
+  char *buckets = NULL;
+  int i = 0;
+  int t = 0;
+
+  if (flags & HASHTABLE_OPEN_ADDRESSING) {
+    // room for count without going over the 7/8 load insertOpen allows
+    table = createHashTableWithFlags(count + count / 7 + 1, hashFunction,
+                                     equalFunction, flags);
+    for (i = 0; i < count; ++i) {
+      insertOpen(table, keys[i], data[i]);
+    }
+    return table;
+  }
+  table = createHashTableWithFlags(count > 0 ? count : 1, hashFunction,
+                                   equalFunction, flags);
+  if (count == 0) {
+    return table;
+  }
+  if (threads > count / BUILD_KEYS_PER_THREAD) {
+    threads = count / BUILD_KEYS_PER_THREAD;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  locations = malloc(sizeof(unsigned int) * count);
+  buckets = slabAllocArray(&table->buckets, count);
+  parts = malloc(sizeof(struct BuildPart) * threads);
+  for (t = 0; t < threads; ++t) {
+    parts[t].table = table;
+    parts[t].keys = keys;
+    parts[t].data = data;
+    parts[t].count = count;
+    parts[t].buckets = buckets;
+    parts[t].locations = locations;
+    parts[t].firstKey = (long)count * t / threads;
+    parts[t].lastKey = (long)count * (t + 1) / threads;
+    parts[t].firstChain = (long)table->size * t / threads;
+    parts[t].lastChain = (long)table->size * (t + 1) / threads;
+  }
+  runParts(fillPart, parts, threads);
+  runParts(linkPart, parts, threads);
+  table->used = count;
+  free(parts);
+  free(locations);
+  return table;
+}
+
 void *findData(HashTable *table, void *key) {
-  unsigned int location = ((table->hashFunction)(key)) % table->size;
-  struct HashBucket *lookAt = table->data[location];
+  if (table->flags & HASHTABLE_OPEN_ADDRESSING) {
+    return findOpen(table, key);
+  }
+  return findDataHashed(table, key, (table->hashFunction)(key));
+}
+
+void *findDataHashed(HashTable *table, void *key, unsigned int hash) {
+  struct HashBucket *lookAt = NULL;
+  int probes = 0;
+  if (table->flags & HASHTABLE_OPEN_ADDRESSING) {
+    return findOpenHashed(table, key, mixHash(hash));
+  }
+  if (table->oldData != NULL) {
+    rehashStep(table, REHASH_STEP);
+  }
+  lookAt = findChain(table, key, hash,
+                     table->data[bucketIndex(table, hash, table->size)],
+                     &probes);
+  /*
+   * Mid resize the key may still be in a bucket that has not moved yet.
+   */
+  if (lookAt == NULL && table->oldData != NULL) {
+    lookAt = findChain(table, key, hash,
+                       table->oldData[bucketIndex(table, hash,
+                                                  table->oldSize)],
+                       &probes);
+  }
+  STATS(countLookup(table, lookAt != NULL, probes));
+  return lookAt != NULL ? lookAt->data : NULL;
+}
+
+/*
+ * Looks up keys[0..n) and stores each result in out.  The keys are done
+ * BATCH_WIDTH at a time: first all of them are hashed and their bucket
+ * slots prefetched, then the chain heads are loaded and prefetched, and
+ * only then are the chains walked, so the cache misses of the different
+ * keys overlap instead of being paid one after another.
+ */
+void findDataBatch(HashTable *table, void **keys, void **out, size_t n) {
+  findDataBatchHashed(table, keys, NULL, out, n);
+}
+
+void findDataBatchHashed(HashTable *table, void **keys,
+                         const unsigned int *keyHashes, void **out,
+                         size_t n) {
+  unsigned int hashes[BATCH_WIDTH];
+  unsigned int locations[BATCH_WIDTH];
+  struct HashBucket *heads[BATCH_WIDTH];
+  size_t done = 0;
+  size_t width = 0;
+  size_t i = 0;
+  if (table->flags & HASHTABLE_OPEN_ADDRESSING) {
+    findOpenBatch(table, keys, keyHashes, out, n);
+    return;
+  }
+  /*
+   * A running incremental resize has two arrays to look in, leave that
+   * to findData (which also finishes the resize soon enough).
+   */
+  while (done < n && table->oldData != NULL) {
+    out[done] = keyHashes != NULL
+                    ? findDataHashed(table, keys[done], keyHashes[done])
+                    : findData(table, keys[done]);
+    done++;
+  }
+  for (; done < n; done += width) {
+    width = n - done < BATCH_WIDTH ? n - done : BATCH_WIDTH;
+    for (i = 0; i < width; ++i) {
+      hashes[i] = keyHashes != NULL ? keyHashes[done + i]
+                                    : (table->hashFunction)(keys[done + i]);
+      locations[i] = bucketIndex(table, hashes[i], table->size);
+      __builtin_prefetch(&table->data[locations[i]]);
+    }
+    for (i = 0; i < width; ++i) {
+      heads[i] = table->data[locations[i]];
+      if (heads[i] != NULL) {
+        __builtin_prefetch(heads[i]);
+      }
+    }
+    for (i = 0; i < width; ++i) {
+      int probes = 0;
+      struct HashBucket *found =
+          findChain(table, keys[done + i], hashes[i], heads[i], &probes);
+      STATS(countLookup(table, found != NULL, probes));
+      out[done + i] = found != NULL ? found->data : NULL;
+    }
+  }
+}
+
+/*
+ * findChain for HASHTABLE_INLINE_KEYS.  A short key is compared with the
+ * copy in the bucket, without loading the bucket's key pointer.
+ */
+static struct HashBucket *findStringChain(const char *key, unsigned int hash,
+                                          struct HashBucket *lookAt,
+                                          int *probes) {
+  size_t length = strlen(key);
+  while (lookAt != NULL) {
+    STATS(*probes += 1);
+    if (lookAt->hash == hash && lookAt->length == length &&
+        memcmp(key,
+               length < HASHTABLE_INLINE_KEY ? lookAt->inlineKey
+                                             : (char *)lookAt->key,
+               length) == 0) {
+      return lookAt;
+    }
+    lookAt = lookAt->next;
+  }
+  return NULL;
+}
+
+/*
+ * Walks the chain starting at lookAt for key, returning its bucket or
+ * NULL.  Adds the buckets it looked at to *probes (with HASHTABLE_STATS).
+ */
+static struct HashBucket *findChain(HashTable *table, void *key,
+                                    unsigned int hash,
+                                    struct HashBucket *lookAt, int *probes) {
+  if (table->flags & HASHTABLE_INLINE_KEYS) {
+    return findStringChain(key, hash, lookAt, probes);
+  }
   while (lookAt != NULL) {
-    if ((table->equalFunction)(key, lookAt->key) != 0) {
-      return lookAt->data;
+    STATS(*probes += 1);
+    if (lookAt->hash == hash &&
+        (table->equalFunction)(key, lookAt->key) != 0) {
+      return lookAt;
     }
     lookAt = lookAt->next;
   }
   return NULL;
 }
+
+/*
+ * Begins an incremental resize to twice the size.  The new array comes
+ * from calloc so large arrays are handed out as already zeroed pages
+ * instead of being cleared here in one go.
+ */
+static void startRehash(HashTable *table) {
+  // rehashStep counts the time finishing the last resize takes itself
+  if (table->oldData != NULL) {
+    rehashStep(table, table->oldSize - table->rehashIndex);
+  }
+  STATS(double start = statsClock());
+  table->oldData = table->data;
+  table->oldSize = table->size;
+  table->rehashIndex = 0;
+  table->size = table->size * 2;
+  table->data = calloc(table->size, sizeof(struct HashBucket *));
+  STATS(table->counters.resizes += 1);
+  STATS(table->counters.resizeSeconds += statsClock() - start);
+}
+
+/*
+ * Moves up to buckets old buckets into the new array, and drops the old
+ * array once it is empty.
+ */
+static void rehashStep(HashTable *table, int buckets) {
+  unsigned int location = 0;
+  STATS(double start = statsClock());
+  while (buckets-- > 0 && table->oldData != NULL) {
+    struct HashBucket *at = table->oldData[table->rehashIndex];
+    struct HashBucket *next = NULL;
+    while (at != NULL) {
+      next = at->next;
+      location = bucketIndex(table, at->hash, table->size);
+      at->next = table->data[location];
+      table->data[location] = at;
+      at = next;
+    }
+    table->oldData[table->rehashIndex] = NULL;
+    table->rehashIndex += 1;
+    if (table->rehashIndex == table->oldSize) {
+      free(table->oldData);
+      table->oldData = NULL;
+    }
+  }
+  STATS(table->counters.resizeSeconds += statsClock() - start);
+}
+
+void finishResize(HashTable *table) {
+  if (table->oldData != NULL) {
+    rehashStep(table, table->oldSize - table->rehashIndex);
+  }
+}
+
+/*
+ * Returns a bitmask with bit i set if control byte i of the group equals
+ * tag.
+ */
+static unsigned int matchGroup(const signed char *group, signed char tag) {
+#ifdef __SSE2__
+  __m128i control = _mm_load_si128((const __m128i *)group);
+  return (unsigned int)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(control, _mm_set1_epi8(tag)));
+#else
+  unsigned int mask = 0;
+  int i = 0;
+  for (i = 0; i < GROUP_WIDTH; ++i) {
+    if (group[i] == tag) {
+      mask |= 1U << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/*
+ * The slot count is always a power of two and at least one group, so the
+ * group index is a mask and the triangular probe sequence over the groups
+ * visits every one of them.
+ */
+static void createOpenTable(HashTable *table, int size) {
+  int capacity = GROUP_WIDTH;
+  int i = 0;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  table->size = capacity;
+  table->used = 0;
+  table->control = aligned_alloc(GROUP_WIDTH, capacity);
+  table->slots = malloc(sizeof(struct HashSlot) * capacity);
+  for (i = 0; i < capacity; ++i) {
+    table->control[i] = CONTROL_EMPTY;
+  }
+}
+
+static void placeOpen(HashTable *table, unsigned int hash, void *key,
+                      void *data) {
+  unsigned int groupMask = table->size / GROUP_WIDTH - 1;
+  unsigned int group = (hash >> 7) & groupMask;
+  unsigned int stride = 0;
+  unsigned int empty = 0;
+  int slot = 0;
+  while ((empty = matchGroup(table->control + group * GROUP_WIDTH,
+                             CONTROL_EMPTY)) == 0) {
+    stride += 1;
+    group = (group + stride) & groupMask;
+  }
+  slot = group * GROUP_WIDTH + __builtin_ctz(empty);
+  table->control[slot] = (signed char)(hash & 0x7f);
+  table->slots[slot].key = key;
+  table->slots[slot].data = data;
+  table->slots[slot].hash = hash;
+  table->used += 1;
+}
+
+static void insertOpen(HashTable *table, void *key, void *data) {
+  /*
+   * Keep at least one empty slot in eight so misses stop early.
+   */
+  if ((table->used + 1) > table->size - table->size / 8) {
+    int oldSize = table->size;
+    signed char *oldControl = table->control;
+    struct HashSlot *oldSlots = table->slots;
+    int i = 0;
+    STATS(double start = statsClock());
+    createOpenTable(table, oldSize * 2);
+    for (i = 0; i < oldSize; ++i) {
+      if (oldControl[i] != CONTROL_EMPTY) {
+        placeOpen(table, oldSlots[i].hash, oldSlots[i].key,
+                  oldSlots[i].data);
+      }
+    }
+    free(oldControl);
+    free(oldSlots);
+    STATS(table->counters.resizes += 1);
+    STATS(table->counters.resizeSeconds += statsClock() - start);
+  }
+  placeOpen(table, mixHash((table->hashFunction)(key)), key, data);
+}
+
+static void *findOpen(HashTable *table, void *key) {
+  return findOpenHashed(table, key, mixHash((table->hashFunction)(key)));
+}
+
+/*
+ * The open table's version of findDataBatch: hash every key of the batch
+ * and prefetch its first control group, then prefetch the slot of the
+ * first tag match in each, then probe.
+ */
+static void findOpenBatch(HashTable *table, void **keys,
+                          const unsigned int *keyHashes, void **out,
+                          size_t n) {
+  unsigned int hashes[BATCH_WIDTH];
+  unsigned int groupMask = table->size / GROUP_WIDTH - 1;
+  size_t done = 0;
+  size_t width = 0;
+  size_t i = 0;
+  for (; done < n; done += width) {
+    width = n - done < BATCH_WIDTH ? n - done : BATCH_WIDTH;
+    for (i = 0; i < width; ++i) {
+      hashes[i] = mixHash(keyHashes != NULL
+                              ? keyHashes[done + i]
+                              : (table->hashFunction)(keys[done + i]));
+      __builtin_prefetch(table->control +
+                         ((hashes[i] >> 7) & groupMask) * GROUP_WIDTH);
+    }
+    for (i = 0; i < width; ++i) {
+      unsigned int group = (hashes[i] >> 7) & groupMask;
+      unsigned int match =
+          matchGroup(table->control + group * GROUP_WIDTH,
+                     (signed char)(hashes[i] & 0x7f));
+      if (match != 0) {
+        __builtin_prefetch(
+            &table->slots[group * GROUP_WIDTH + __builtin_ctz(match)]);
+      }
+    }
+    for (i = 0; i < width; ++i) {
+      out[done + i] = findOpenHashed(table, keys[done + i], hashes[i]);
+    }
+  }
+}
+
+/*
+ * hash is the mixed hash of key.
+ */
+static void *findOpenHashed(HashTable *table, void *key, unsigned int hash) {
+  unsigned int groupMask = table->size / GROUP_WIDTH - 1;
+  unsigned int group = (hash >> 7) & groupMask;
+  unsigned int stride = 0;
+  signed char tag = (signed char)(hash & 0x7f);
+  STATS(int probes = 0);
+  while (1) {
+    signed char *control = table->control + group * GROUP_WIDTH;
+    unsigned int match = matchGroup(control, tag);
+    STATS(probes += 1);
+    while (match != 0) {
+      struct HashSlot *slot =
+          &table->slots[group * GROUP_WIDTH + __builtin_ctz(match)];
+      if (slot->hash == hash &&
+          (table->equalFunction)(key, slot->key) != 0) {
+        STATS(countLookup(table, 1, probes));
+        return slot->data;
+      }
+      match &= match - 1;
+    }
+    if (matchGroup(control, CONTROL_EMPTY) != 0) {
+      STATS(countLookup(table, 0, probes));
+      return NULL;
+    }
+    stride += 1;
+    group = (group + stride) & groupMask;
+  }
+}
+
+/*
+ * Which group of the probe sequence (0 for the first) the open table's
+ * slot is in.
+ */
+static int probeDistance(HashTable *table, int slot) {
+  unsigned int groupMask = table->size / GROUP_WIDTH - 1;
+  unsigned int group = (table->slots[slot].hash >> 7) & groupMask;
+  unsigned int stride = 0;
+  int distance = 0;
+  while (group != (unsigned int)slot / GROUP_WIDTH) {
+    stride += 1;
+    group = (group + stride) & groupMask;
+    distance += 1;
+  }
+  return distance;
+}
+
+/*
+ * Adds the chains of buckets[from] to buckets[to - 1] to stats.
+ */
+static void countChains(struct HashTableStats *stats,
+                        struct HashBucket **buckets, int from, int to) {
+  int i = 0;
+  for (i = from; i < to; ++i) {
+    int length = 0;
+    struct HashBucket *at = buckets[i];
+    while (at != NULL) {
+      length += 1;
+      at = at->next;
+    }
+    if (length > stats->maxChain) {
+      stats->maxChain = length;
+    }
+    if (length >= HASHTABLE_STATS_BINS) {
+      length = HASHTABLE_STATS_BINS - 1;
+    }
+    stats->chainLengths[length] += 1;
+  }
+}
+
+void getHashTableStats(HashTable *table, struct HashTableStats *stats) {
+  int i = 0;
+  memset(stats, 0, sizeof(struct HashTableStats));
+  stats->size = table->size;
+  stats->used = table->used;
+  stats->loadFactor = (double)table->used / table->size;
+  if (table->flags & HASHTABLE_OPEN_ADDRESSING) {
+    stats->arrayBytes = (long)table->size * (sizeof(struct HashSlot) + 1);
+    for (i = 0; i < table->size; ++i) {
+      int distance = 0;
+      if (table->control[i] == CONTROL_EMPTY) {
+        continue;
+      }
+      distance = probeDistance(table, i);
+      if (distance + 1 > stats->maxChain) {
+        stats->maxChain = distance + 1;
+      }
+      if (distance >= HASHTABLE_STATS_BINS) {
+        distance = HASHTABLE_STATS_BINS - 1;
+      }
+      stats->chainLengths[distance] += 1;
+    }
+  }
+  else {
+    stats->arrayBytes = (long)table->size * sizeof(struct HashBucket *);
+    if (table->oldData != NULL) {
+      stats->arrayBytes += (long)table->oldSize * sizeof(struct HashBucket *);
+    }
+    stats->nodeBytes = slabPoolBytes(&table->buckets);
+    countChains(stats, table->data, 0, table->size);
+    if (table->oldData != NULL) {
+      countChains(stats, table->oldData, table->rehashIndex, table->oldSize);
+    }
+  }
+#ifdef HASHTABLE_STATS
+  stats->counted = 1;
+  stats->counters = table->counters;
+#endif
+}
+
+void printHashTableStats(HashTable *table, FILE *out) {
+  struct HashTableStats stats;
+  struct HashTableCounters *counters = &stats.counters;
+  int open = table->flags & HASHTABLE_OPEN_ADDRESSING;
+  int i = 0;
+  getHashTableStats(table, &stats);
+  fprintf(out, "hashtable: %d entries in %d %s, load factor %.2f\n",
+          stats.used, stats.size, open ? "slots" : "buckets",
+          stats.loadFactor);
+  fprintf(out, "%s:", open ? "entries by group probed" : "chain lengths");
+  for (i = 0; i < HASHTABLE_STATS_BINS; ++i) {
+    fprintf(out, " %d%s:%ld", open ? i + 1 : i,
+            i == HASHTABLE_STATS_BINS - 1 ? "+" : "", stats.chainLengths[i]);
+  }
+  fprintf(out, " (max %d)\n", stats.maxChain);
+  fprintf(out, "memory: %ld bytes array, %ld bytes nodes\n", stats.arrayBytes,
+          stats.nodeBytes);
+  if (!stats.counted) {
+    fprintf(out, "lookup and resize counters: not built in "
+                 "(compile hashtable.c with -DHASHTABLE_STATS)\n");
+    return;
+  }
+  fprintf(out, "findData hits: %ld, %.2f probes avg, %d max\n", counters->hits,
+          counters->hits ? (double)counters->hitProbes / counters->hits : 0.0,
+          counters->maxHitProbes);
+  fprintf(out, "findData misses: %ld, %.2f probes avg, %d max\n",
+          counters->misses,
+          counters->misses ? (double)counters->missProbes / counters->misses
+                           : 0.0,
+          counters->maxMissProbes);
+  fprintf(out, "resizes: %ld, %.3f ms\n", counters->resizes,
+          counters->resizeSeconds * 1e3);
+}
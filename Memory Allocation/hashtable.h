@@ -1,4 +1,3 @@
-
 /*
  * This is so the C preprocessor does not try to include multiple copies
  * of the header file if someone uses multiple #include directives.
@@ -6,6 +5,9 @@
 #ifndef _HASHTABLE_H_
 #define _HASHTABLE_H_
 
+#include <stdio.h>
+#include "slab.h"
+
 #ifndef NULL
 #define NULL ((void *)0)
 #endif
@@ -16,10 +18,111 @@
  * compute the hash and an int (*) (void *, void *) for equal true/false
  */
 
+/*
+ * hash caches the key's hashFunction value, so resizes never call the
+ * hash function again and chain walks skip equalFunction on buckets
+ * whose hash differs.
+ *
+ * length and inlineKey are only used with HASHTABLE_INLINE_KEYS: length
+ * is the key's strlen, and a key shorter than HASHTABLE_INLINE_KEY bytes
+ * is copied (with its NUL) into inlineKey, which key then points to.
+ * length fits in what was padding, so the bucket of the other layouts
+ * stays 32 bytes.
+ */
 struct HashBucket {
   void *key;
   void *data;
   struct HashBucket *next;
+  unsigned int hash;
+  unsigned int length;
+  char inlineKey[];
+};
+
+/*
+ * One entry of the open addressing backend.  The slots live in a single
+ * array next to a parallel array of one byte control tags, so a probe
+ * only touches the slot once the tag already matched.  Like a bucket, a
+ * slot keeps its (mixed) hash for resizes and comparisons.
+ */
+struct HashSlot {
+  void *key;
+  void *data;
+  unsigned int hash;
+};
+
+/*
+ * Flags for createHashTableWithFlags().  The default (0) is the
+ * separately chained table.
+ *
+ * HASHTABLE_OPEN_ADDRESSING selects an open addressing table whose
+ * control bytes are probed a group of 16 at a time (with SSE2 when the
+ * compiler has it).  It never deletes, so it needs no tombstones.
+ */
+#define HASHTABLE_OPEN_ADDRESSING 0x1
+
+/*
+ * HASHTABLE_INCREMENTAL makes the chained table grow incrementally: the
+ * old and new bucket arrays are kept side by side and every insertData
+ * and findData moves a few old buckets across, instead of one insert
+ * paying for moving the whole table.
+ */
+#define HASHTABLE_INCREMENTAL 0x2
+
+/*
+ * HASHTABLE_POW2 rounds the chained table up to a power of two and picks
+ * the bucket by masking a mixed hash instead of dividing by the size.
+ */
+#define HASHTABLE_POW2 0x4
+
+/*
+ * HASHTABLE_INLINE_KEYS is for NUL terminated string keys, in the
+ * chained table (the open table ignores it).  Each bucket is
+ * HASHTABLE_INLINE_KEY bytes larger and holds a copy of a short key, so
+ * a lookup compares against the bucket it already loaded instead of
+ * following the key pointer to another cache miss.  Longer keys stay
+ * where the caller put them.  Keys are compared by length and bytes;
+ * equalFunction is not called.
+ */
+#define HASHTABLE_INLINE_KEYS 0x8
+#define HASHTABLE_INLINE_KEY 16
+
+/*
+ * Counters kept while the table is used, only when hashtable.c is built
+ * with -DHASHTABLE_STATS.  Without it nothing is counted (and the hot
+ * paths contain no counting code at all).  A probe is one bucket (or,
+ * for the open table, one control group) looked at by findData.
+ */
+struct HashTableCounters {
+  long hits;
+  long misses;
+  long hitProbes;
+  long missProbes;
+  int maxHitProbes;
+  int maxMissProbes;
+  long resizes;
+  double resizeSeconds;
+};
+
+/*
+ * A snapshot from getHashTableStats().  chainLengths[i] is the number of
+ * buckets with a chain of i entries, the last bin counting that many or
+ * more.  During an incremental resize the buckets of oldData not moved
+ * yet are counted too, so the chains still hold all used entries.  For
+ * the open table it is instead the number of entries found in the
+ * (i + 1)th control group probed.
+ */
+#define HASHTABLE_STATS_BINS 8
+
+struct HashTableStats {
+  int size;
+  int used;
+  double loadFactor;
+  long chainLengths[HASHTABLE_STATS_BINS];
+  int maxChain;
+  long arrayBytes;
+  long nodeBytes;
+  int counted;
+  struct HashTableCounters counters;
 };
 
 typedef struct HashTable {
@@ -28,12 +131,44 @@ typedef struct HashTable {
   struct HashBucket **data;
   int size;
   int used;
+  int flags;
+  signed char *control;
+  struct HashSlot *slots;
+  SlabPool buckets;
+  /*
+   * While an incremental resize is running, the buckets of oldData below
+   * rehashIndex have been moved into data and the rest have not.
+   */
+  struct HashBucket **oldData;
+  int oldSize;
+  int rehashIndex;
+  struct HashTableCounters counters;
 } HashTable;
 
 extern HashTable *createHashTable(int size,
                                   unsigned int (*hashFunction)(void *),
                                   int (*equalFunction)(void *, void *));
 
+extern HashTable *createHashTableWithFlags(int size,
+                                           unsigned int (*hashFunction)(void *),
+                                           int (*equalFunction)(void *, void *),
+                                           int flags);
+
+/*
+ * Builds a table of count keys at once, data[i] being the data of
+ * keys[i]; the same as inserting them in order into a new table, but
+ * sized once for count so it never resizes.  The chained table is built
+ * on up to threads threads: they hash the keys and fill in the buckets a
+ * slice of the keys each, then link them into the chains, each thread
+ * owning a range of the chains so none of them write to the same one.
+ * (The open table is filled on the calling thread.)  Small tables are
+ * not worth the threads and use fewer.
+ */
+extern HashTable *buildHashTable(void **keys, void **data, int count,
+                                 unsigned int (*hashFunction)(void *),
+                                 int (*equalFunction)(void *, void *),
+                                 int flags, int threads);
+
 /*
  * If you insert with a key that already exists this is undefined behavior:
  * Future fetches may sometimes get the new data or sometimes the old data,
@@ -43,6 +178,45 @@ extern void insertData(HashTable *table, void *key, void *data);
 
 extern void *findData(HashTable *table, void *key);
 
+/*
+ * findData for a key whose hash the caller already has: hash has to be
+ * hashFunction(key).  The key is then only read by equalFunction, on the
+ * entries whose hash matches.
+ */
+extern void *findDataHashed(HashTable *table, void *key, unsigned int hash);
+
+/*
+ * Looks up n keys at once, out[i] = findData(table, keys[i]), overlapping
+ * the memory accesses of the different lookups.
+ */
+extern void findDataBatch(HashTable *table, void **keys, void **out,
+                          size_t n);
+
+/*
+ * findDataBatch for keys whose hashes the caller already has: keyHashes[i]
+ * has to be hashFunction(keys[i]).  keyHashes may be NULL, then the keys
+ * are hashed here, as in findDataBatch.
+ */
+extern void findDataBatchHashed(HashTable *table, void **keys,
+                                const unsigned int *keyHashes, void **out,
+                                size_t n);
+
+/*
+ * Completes an incremental resize that is still under way.  Afterwards
+ * findData and findDataBatch do not modify the table, so several threads
+ * may look up in it at once as long as nobody inserts.
+ */
+extern void finishResize(HashTable *table);
+
 extern void freeTable(HashTable *table);
 
+/*
+ * Fills in stats for the table.  The shape of the table (load factor,
+ * chain lengths, memory) is measured on the spot, the counters are only
+ * there (and stats->counted nonzero) with -DHASHTABLE_STATS.
+ */
+extern void getHashTableStats(HashTable *table, struct HashTableStats *stats);
+
+extern void printHashTableStats(HashTable *table, FILE *out);
+
 #endif
@@ -0,0 +1,169 @@
+/*
+ * Startup benchmark for philspel's ways of loading a dictionary: reading
+ * the text word list (one fscanf, malloc and insertData per word, as
+ * readDictionary does for a pipe), mapping the word list and inserting
+ * the words in place, and mapping a prebuilt image.  All are timed
+ * from nothing to a usable dictionary, then to the end of a first batch
+ * of lookups, since the image pays for its page faults there instead.
+ *
+ * usage: ./imagebench [words] [lookups]
+ */
+#include "dictimage.h"
+#include "hashtable.h"
+#include "wordhash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEXT_FILE "imagebench.txt"
+#define IMAGE_FILE "imagebench.img"
+
+/*
+ * Same hash and strcmp equality that philspel uses.
+ */
+static unsigned int stringHash(void *s) {
+  return wordHash((char *)s, strlen((char *)s));
+}
+
+static int stringEquals(void *s1, void *s2) {
+  return strcmp((char *)s1, (char *)s2) == 0;
+}
+
+static unsigned long long rngState = 88172645463325252ULL;
+
+static unsigned long long nextRandom(void) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return rngState;
+}
+
+static char *randomWord(void) {
+  int length = 3 + nextRandom() % 10;
+  char *word = malloc(length + 1);
+  int i = 0;
+  for (i = 0; i < length; ++i) {
+    word[i] = 'a' + nextRandom() % 26;
+  }
+  word[length] = '\0';
+  return word;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * readDictionary's fscanf loop, minus the bookkeeping philspel needs to
+ * free the words.
+ */
+static HashTable *readText(char ***copies, int words) {
+  HashTable *table = createHashTable(999, stringHash, stringEquals);
+  char *store = malloc(9999);
+  FILE *f = fopen(TEXT_FILE, "r");
+  int i = 0;
+  *copies = malloc(sizeof(char *) * words);
+  while (i < words && fscanf(f, "%s", store) != EOF) {
+    char *copy = malloc(strlen(store) + 1);
+    strcpy(copy, store);
+    (*copies)[i++] = copy;
+    insertData(table, copy, copy);
+  }
+  fclose(f);
+  free(store);
+  return table;
+}
+
+int main(int argc, char **argv) {
+  int words = argc > 1 ? atoi(argv[1]) : 500000;
+  int lookups = argc > 2 ? atoi(argv[2]) : 100000;
+  char **list = malloc(sizeof(char *) * words);
+  char **keys = malloc(sizeof(char *) * lookups);
+  char **copies = NULL;
+  HashTable *table = NULL;
+  HashTable *mappedTable = NULL;
+  MappedWords *mapped = NULL;
+  DictionaryImage *image = NULL;
+  FILE *f = fopen(TEXT_FILE, "w");
+  double start, textLoad, textFirst, mappedLoad, mappedFirst;
+  double imageLoad, imageFirst, writeTime;
+  long textFound = 0;
+  long mappedFound = 0;
+  long imageFound = 0;
+  int i = 0;
+
+  for (i = 0; i < words; ++i) {
+    list[i] = randomWord();
+    fprintf(f, "%s\n", list[i]);
+  }
+  fclose(f);
+  for (i = 0; i < lookups; ++i) {
+    keys[i] = list[nextRandom() % words];
+  }
+
+  start = now();
+  table = readText(&copies, words);
+  textLoad = now() - start;
+  for (i = 0; i < lookups; ++i) {
+    textFound += findData(table, keys[i]) != NULL;
+  }
+  textFirst = now() - start;
+
+  start = now();
+  mapped = mapWordList(TEXT_FILE);
+  mappedTable = createHashTable(999, stringHash, stringEquals);
+  for (i = 0; i < mapped->count; ++i) {
+    insertData(mappedTable, mapped->words[i], mapped->words[i]);
+  }
+  mappedLoad = now() - start;
+  for (i = 0; i < lookups; ++i) {
+    mappedFound += findData(mappedTable, keys[i]) != NULL;
+  }
+  mappedFirst = now() - start;
+
+  start = now();
+  if (writeDictionaryImage(IMAGE_FILE, list, words, stringHash) != 0) {
+    perror(IMAGE_FILE);
+    return 1;
+  }
+  writeTime = now() - start;
+
+  start = now();
+  image = openDictionaryImage(IMAGE_FILE, stringHash);
+  imageLoad = now() - start;
+  for (i = 0; i < lookups; ++i) {
+    imageFound += findImageData(image, keys[i]) != NULL;
+  }
+  imageFirst = now() - start;
+
+  if (textFound != mappedFound || textFound != imageFound) {
+    fprintf(stderr, "the dictionaries disagree\n");
+    return 1;
+  }
+  printf("%d words, %d lookups after loading, times in ms\n", words, lookups);
+  printf("%-8s %12s %16s\n", "", "load", "load + lookups");
+  printf("%-8s %12.3f %16.3f\n", "text", textLoad / 1e6, textFirst / 1e6);
+  printf("%-8s %12.3f %16.3f\n", "mapped", mappedLoad / 1e6,
+         mappedFirst / 1e6);
+  printf("%-8s %12.3f %16.3f\n", "image", imageLoad / 1e6, imageFirst / 1e6);
+  printf("writing the image took %.3f ms, it is %zu bytes\n", writeTime / 1e6,
+         image->size);
+
+  closeDictionaryImage(image);
+  freeTable(table);
+  freeTable(mappedTable);
+  unmapWordList(mapped);
+  for (i = 0; i < words; ++i) {
+    free(list[i]);
+    free(copies[i]);
+  }
+  free(list);
+  free(copies);
+  free(keys);
+  remove(TEXT_FILE);
+  remove(IMAGE_FILE);
+  return 0;
+}
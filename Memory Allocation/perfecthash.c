@@ -0,0 +1,240 @@
+#include "perfecthash.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * The murmur3 64 bit finalizer.
+ */
+static uint64_t mixHash(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/*
+ * 64 bit FNV-1a.  The user hash functions are only 32 bits, which a
+ * dictionary of a few hundred thousand words is likely to collide in,
+ * and two keys with the same hash can never be told apart by any seed.
+ */
+static uint64_t keyHash(const char *key) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  while (*key) {
+    hash ^= (unsigned char)*key++;
+    hash *= 0x100000001b3ULL;
+  }
+  return mixHash(hash);
+}
+
+/*
+ * Maps a 32 bit value onto 0 .. range - 1 without a division.
+ */
+static uint32_t reduce(uint32_t value, uint32_t range) {
+  return (uint32_t)(((uint64_t)value * range) >> 32);
+}
+
+static uint32_t bucketOf(uint64_t hash, uint32_t buckets) {
+  return reduce((uint32_t)(hash >> 32), buckets);
+}
+
+static uint32_t slotOf(uint64_t hash, uint32_t seed, uint32_t count) {
+  return reduce((uint32_t)mixHash(hash ^ (seed * 0x9e3779b97f4a7c15ULL)),
+                count);
+}
+
+/*
+ * Looks for a seed that puts all size keys of a bucket (their hashes in
+ * hashes) into different free slots, and takes those slots.
+ */
+static int placeBucket(uint64_t *hashes, uint32_t size, uint32_t count,
+                       unsigned char *taken, uint32_t *slots,
+                       uint32_t *seed) {
+  /*
+   * The last buckets have to find one of the few slots left, which takes
+   * about count / free tries each.
+   */
+  uint64_t limit = 100 * (uint64_t)count + 1000;
+  uint32_t i = 0;
+  uint32_t j = 0;
+  for (*seed = 0; *seed < limit; ++*seed) {
+    for (i = 0; i < size; ++i) {
+      slots[i] = slotOf(hashes[i], *seed, count);
+      if (taken[slots[i]]) {
+        break;
+      }
+      for (j = 0; j < i && slots[j] != slots[i]; ++j) {
+      }
+      if (j < i) {
+        break;
+      }
+    }
+    if (i == size) {
+      for (i = 0; i < size; ++i) {
+        taken[slots[i]] = 1;
+      }
+      return 1;
+    }
+  }
+  return 0;
+}
+
+PerfectHashTable *createPerfectHashTable(char **keys, void **data,
+                                         int count) {
+  PerfectHashTable *table = malloc(sizeof(PerfectHashTable));
+  uint64_t *hashes = malloc(sizeof(uint64_t) * (count + 1));
+  uint32_t *order = malloc(sizeof(uint32_t) * (count + 1));
+  uint32_t *bucketStart = NULL;
+  uint32_t *bucketSize = NULL;
+  uint32_t *bySize = NULL;
+  uint32_t *sizeStart = NULL;
+  uint64_t bucketHashes[64];
+  uint32_t bucketKeys[64];
+  uint32_t bucketSlots[64];
+  unsigned char *taken = NULL;
+  uint32_t maxSize = 0;
+  uint32_t unique = 0;
+  uint32_t b = 0;
+  int failed = 0;
+  int i = 0;
+  int j = 0;
+
+  table->buckets = (count + PERFECTHASH_BUCKET_KEYS - 1) /
+                   PERFECTHASH_BUCKET_KEYS;
+  if (table->buckets == 0) {
+    table->buckets = 1;
+  }
+  table->seeds = calloc(table->buckets, sizeof(uint32_t));
+  bucketStart = calloc(table->buckets + 1, sizeof(uint32_t));
+  bucketSize = calloc(table->buckets, sizeof(uint32_t));
+
+  /*
+   * Sort the keys by bucket (a counting sort), then drop the repeated
+   * keys of each bucket.
+   */
+  for (i = 0; i < count; ++i) {
+    hashes[i] = keyHash(keys[i]);
+    bucketStart[bucketOf(hashes[i], table->buckets)] += 1;
+  }
+  for (b = 1; b <= table->buckets; ++b) {
+    bucketStart[b] += bucketStart[b - 1];
+  }
+  for (i = count - 1; i >= 0; --i) {
+    order[--bucketStart[bucketOf(hashes[i], table->buckets)]] = i;
+  }
+  for (b = 0; b < table->buckets && !failed; ++b) {
+    uint32_t *members = order + bucketStart[b];
+    uint32_t size = bucketStart[b + 1] - bucketStart[b];
+    uint32_t k = 0;
+    uint32_t kept = 0;
+    for (k = 0; k < size; ++k) {
+      uint32_t m = 0;
+      for (m = 0; m < kept; ++m) {
+        if (hashes[members[m]] == hashes[members[k]]) {
+          break;
+        }
+      }
+      if (m == kept) {
+        members[kept++] = members[k];
+      }
+      else if (strcmp(keys[members[m]], keys[members[k]]) != 0) {
+        failed = 1;
+      }
+    }
+    bucketSize[b] = kept;
+    unique += kept;
+    if (kept > maxSize) {
+      maxSize = kept;
+    }
+  }
+  if (maxSize > sizeof(bucketKeys) / sizeof(bucketKeys[0])) {
+    failed = 1;
+  }
+
+  /*
+   * Place the buckets largest first, while there are still many free
+   * slots for them.
+   */
+  table->count = unique;
+  table->slots = malloc(sizeof(struct PerfectSlot) * (unique + 1));
+  taken = calloc(unique + 1, 1);
+  sizeStart = calloc(maxSize + 2, sizeof(uint32_t));
+  bySize = malloc(sizeof(uint32_t) * table->buckets);
+  for (b = 0; b < table->buckets; ++b) {
+    sizeStart[maxSize - bucketSize[b] + 1] += 1;
+  }
+  for (i = 1; i <= (int)maxSize + 1; ++i) {
+    sizeStart[i] += sizeStart[i - 1];
+  }
+  for (b = 0; b < table->buckets; ++b) {
+    bySize[sizeStart[maxSize - bucketSize[b]]++] = b;
+  }
+  for (b = 0; b < table->buckets && !failed; ++b) {
+    uint32_t bucket = bySize[b];
+    uint32_t size = bucketSize[bucket];
+    if (size == 0) {
+      break;
+    }
+    for (j = 0; j < (int)size; ++j) {
+      bucketKeys[j] = order[bucketStart[bucket] + j];
+      bucketHashes[j] = hashes[bucketKeys[j]];
+    }
+    if (!placeBucket(bucketHashes, size, unique, taken, bucketSlots,
+                     &table->seeds[bucket])) {
+      failed = 1;
+      break;
+    }
+    for (j = 0; j < (int)size; ++j) {
+      table->slots[bucketSlots[j]].key = keys[bucketKeys[j]];
+      table->slots[bucketSlots[j]].data = data[bucketKeys[j]];
+    }
+  }
+
+  free(hashes);
+  free(order);
+  free(bucketStart);
+  free(bucketSize);
+  free(bySize);
+  free(sizeStart);
+  free(taken);
+  if (failed) {
+    freePerfectHashTable(table);
+    return NULL;
+  }
+  return table;
+}
+
+void *findPerfectData(PerfectHashTable *table, const char *key) {
+  uint64_t hash = keyHash(key);
+  struct PerfectSlot *slot = NULL;
+  if (table->count == 0) {
+    return NULL;
+  }
+  slot = &table->slots[slotOf(
+      hash, table->seeds[bucketOf(hash, table->buckets)], table->count)];
+  if (strcmp(key, slot->key) != 0) {
+    return NULL;
+  }
+  return slot->data;
+}
+
+size_t perfectHashBytes(PerfectHashTable *table) {
+  return sizeof(uint32_t) * table->buckets +
+         sizeof(struct PerfectSlot) * table->count;
+}
+
+void printPerfectHashStats(PerfectHashTable *table, FILE *out) {
+  fprintf(out, "perfect hash: %u keys in %u buckets\n", table->count,
+          table->buckets);
+  fprintf(out, "memory: %zu bytes, %.2f bytes per key\n",
+          perfectHashBytes(table),
+          table->count ? (double)perfectHashBytes(table) / table->count : 0.0);
+}
+
+void freePerfectHashTable(PerfectHashTable *table) {
+  free(table->seeds);
+  free(table->slots);
+  free(table);
+}
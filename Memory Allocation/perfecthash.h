@@ -0,0 +1,62 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _PERFECTHASH_H_
+#define _PERFECTHASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A read only table of string keys built around a minimal perfect hash
+ * function (CHD, "hash and displace"): every key gets a slot of its own
+ * and there are exactly as many slots as keys, so there are no chains
+ * and no empty slots.
+ *
+ * The keys are split into buckets of about PERFECTHASH_BUCKET_KEYS keys
+ * by their hash.  Each bucket has a seed, and a key's slot is its hash
+ * mixed with the seed of its bucket; the build tries seeds for the
+ * largest buckets first until all of a bucket's keys land in free slots.
+ * A lookup is one hash, one seed, one slot and one string compare.
+ *
+ * Keys are not copied, they have to outlive the table.
+ */
+#define PERFECTHASH_BUCKET_KEYS 4
+
+struct PerfectSlot {
+  const char *key;
+  void *data;
+};
+
+typedef struct PerfectHashTable {
+  uint32_t count;
+  uint32_t buckets;
+  uint32_t *seeds;
+  struct PerfectSlot *slots;
+} PerfectHashTable;
+
+/*
+ * Builds the table from count keys and their data.  A key that appears
+ * more than once is stored once, with its first data.  Returns NULL if no
+ * perfect hash was found (two different keys with the same 64 bit hash).
+ */
+extern PerfectHashTable *createPerfectHashTable(char **keys, void **data,
+                                                int count);
+
+/*
+ * Returns the data of key, or NULL if key is not in the table.
+ */
+extern void *findPerfectData(PerfectHashTable *table, const char *key);
+
+/*
+ * The bytes of the seeds and slots (not counting the keys).
+ */
+extern size_t perfectHashBytes(PerfectHashTable *table);
+
+extern void printPerfectHashStats(PerfectHashTable *table, FILE *out);
+
+extern void freePerfectHashTable(PerfectHashTable *table);
+
+#endif
@@ -28,6 +28,62 @@
  */
 #include <string.h>
 
+/*
+ * The prebuilt, mmap()ed dictionary images.
+ */
+#include "dictimage.h"
+
+/*
+ * The minimal perfect hash tables.
+ */
+#include "perfecthash.h"
+
+/*
+ * The Bloom filter in front of the dictionary.
+ */
+#include "bloom.h"
+
+/*
+ * The DAWG of the dictionary, followed a letter at a time.
+ */
+#include "dawg.h"
+
+/*
+ * The spelling suggestions for unknown words.
+ */
+#include "suggest.h"
+
+/*
+ * Threads, for checking chunks of the input in parallel.
+ */
+#include <pthread.h>
+
+/*
+ * The vectorized word splitting.
+ */
+#include "tokenize.h"
+
+/*
+ * The word at a time string hash.
+ */
+#include "wordhash.h"
+
+/*
+ * per-phase timing and counters for --profile, see profile.h.
+ */
+#include "profile.h"
+
+/*
+ * The Unix domain socket, epoll and signal handling of --serve.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
 /*
  * this hashtable stores the dictionary.  For this purpose you really
  * want to just use a set: "is a word in the dictionary or not", so
@@ -36,25 +92,434 @@
  */
 HashTable *dictionary;
 
+/*
+ * the HASHTABLE_ flags the dictionary is created with.
+ */
+static int tableFlags;
+
+/*
+ * every word copied into the dictionary, so they can be released when
+ * the dictionary is freed (the hashtable does not own its keys).
+ */
+static char **dictionaryWords;
+static int dictionaryWordCount;
+static int dictionaryWordCapacity;
+
+/*
+ * the dictionary when it was loaded from an image (--image) instead, in
+ * which case dictionary is NULL.
+ */
+static DictionaryImage *dictionaryImage;
+
+/*
+ * the dictionary file, when it could be mapped: its words are then used
+ * where they are instead of being copied into dictionaryWords.
+ */
+static MappedWords *mappedDictionary;
+
+/*
+ * with --perfect the words are only collected by readDictionary, and
+ * then looked up in a minimal perfect hash table built over all of them.
+ */
+static int perfectHash;
+static PerfectHashTable *perfectDictionary;
+
+/*
+ * with --dawg the words are likewise only collected, and then stored in
+ * a minimized DAWG: one array of 4 byte edges, with the common prefixes
+ * and suffixes of the words shared.  Words are checked by walking it.
+ */
+static int useDawg;
+static Dawg *dawgDictionary;
+
+/*
+ * with --bloom rate, a Bloom filter of every dictionary key (the
+ * lowercase forms with --single-probe) with false positive rate rate.
+ * Lookups check it first, so most words that are not in the dictionary
+ * never touch it.
+ */
+static double bloomRate;
+static BloomFilter *bloomFilter;
+
+/*
+ * with --single-probe the dictionary is keyed by the lowercase form of
+ * its words, and the data of each key says which spellings of it are
+ * correct, so a word is checked with one lookup instead of three.  The
+ * three spellings processInput tries of a word w are w itself, w with all
+ * but the first letter lowercased and w all lowercase, so a dictionary
+ * word d accepts
+ *
+ *   any w with the same lowercase form, if d is all lowercase
+ *   any w with the same lowercase form and an uppercase first letter,
+ *     if only the first letter of d is uppercase (FOLD_CAPITAL)
+ *   only w == d otherwise (the exact spellings)
+ */
+#define FOLD_ANY 1
+#define FOLD_CAPITAL 2
+
+struct FoldedWord {
+  struct FoldedWord *next;
+  int accepts;
+  int exactCount;
+  char **exact;
+  char word[];
+};
+
+static int singleProbe;
+static struct FoldedWord *foldedWords;
+
+/*
+ * with --suggest distance, readDictionary also builds a symmetric delete
+ * index of the dictionary, and every unknown word is followed by the
+ * (up to SUGGESTIONS) closest dictionary words within that edit distance:
+ * "taest [sic] (test, teat)".
+ */
+#define SUGGESTIONS 3
+
+static int suggestDistance;
+static SuggestionIndex *suggestionIndex;
+
+/*
+ * with --profile (or --profile-json), where the run spent its time is
+ * printed to stderr at the end.  The counting is only built in with
+ * -DPHILSPEL_PROFILE.
+ */
+static int profile;
+
+/*
+ * print how to run the program and exit.
+ */
+static void usage(char *program) {
+  fprintf(stderr, "usage: %s [options] dictionary\n", program);
+  fprintf(stderr, "  --image            the dictionary is an image written by --write-image\n");
+  fprintf(stderr, "  --write-image file write the dictionary as an image to file and exit\n");
+  fprintf(stderr, "  --open-addressing  store the dictionary in an open addressing table\n");
+  fprintf(stderr, "  --incremental      grow the dictionary incrementally\n");
+  fprintf(stderr, "  --pow2             use a power of two number of buckets\n");
+  fprintf(stderr, "  --inline-keys      keep short words in the buckets themselves\n");
+  fprintf(stderr, "  --batch            look words up in batches with findDataBatch\n");
+  fprintf(stderr, "  --block            read and write the text in large blocks\n");
+  fprintf(stderr, "  --threads n        check the text in chunks on n threads\n");
+  fprintf(stderr, "  --perfect          look words up in a minimal perfect hash of the dictionary\n");
+  fprintf(stderr, "  --dawg             look words up in a minimized DAWG of the dictionary\n");
+  fprintf(stderr, "                     (checks in blocks, not with --image, --batch, --perfect,\n");
+  fprintf(stderr, "                     --bloom or --single-probe)\n");
+  fprintf(stderr, "  --bloom rate       reject most misses with a Bloom filter of this false positive rate\n");
+  fprintf(stderr, "  --single-probe     fold case in the dictionary, one lookup per word\n");
+  fprintf(stderr, "                     (checks in blocks, not with --image or --batch)\n");
+  fprintf(stderr, "  --suggest distance follow unknown words by dictionary words within distance (1 or 2)\n");
+  fprintf(stderr, "                     (checks in blocks, not with --image or --batch)\n");
+  fprintf(stderr, "  --serve socket     check documents for spellclient on a Unix domain socket\n");
+  fprintf(stderr, "  --stats            print the dictionary's hashtable stats to stderr\n");
+  fprintf(stderr, "  --profile          print the time of each phase and the word counts to stderr\n");
+  fprintf(stderr, "  --profile-json     the same, as a JSON object\n");
+  exit(0);
+}
+
 /*
  * the MAIN routine.  You can safely print debugging information
  * to standard error (stderr) and it will be ignored in the grading
  * process, in the same way which this does.
  */
 int main(int argc, char **argv) {
+  char *dictName = NULL;
+  int flags = 0;
+  int batch = 0;
+  int block = 0;
+  int threads = 0;
+  int stats = 0;
+  int image = 0;
+  char *imageName = NULL;
+  char *socketName = NULL;
+  int i;
 
-  // make the dictionary
-  dictionary = createHashTable(999, stringHash, stringEquals);
-  readDictionary(argv[1]);
+  // read the options, the remaining argument is the dictionary
+  for (i = 1; i < argc; i++){
+    if (strcmp(argv[i], "--open-addressing") == 0){
+      flags |= HASHTABLE_OPEN_ADDRESSING;
+    }
+    else if (strcmp(argv[i], "--incremental") == 0){
+      flags |= HASHTABLE_INCREMENTAL;
+    }
+    else if (strcmp(argv[i], "--pow2") == 0){
+      flags |= HASHTABLE_POW2;
+    }
+    else if (strcmp(argv[i], "--inline-keys") == 0){
+      flags |= HASHTABLE_INLINE_KEYS;
+    }
+    else if (strcmp(argv[i], "--batch") == 0){
+      batch = 1;
+    }
+    else if (strcmp(argv[i], "--block") == 0){
+      block = 1;
+    }
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc){
+      threads = atoi(argv[++i]);
+      if (threads < 1){
+        usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "--perfect") == 0){
+      perfectHash = 1;
+    }
+    else if (strcmp(argv[i], "--dawg") == 0){
+      useDawg = 1;
+    }
+    else if (strcmp(argv[i], "--bloom") == 0 && i + 1 < argc){
+      bloomRate = atof(argv[++i]);
+      if (bloomRate <= 0 || bloomRate >= 1){
+        usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "--single-probe") == 0){
+      singleProbe = 1;
+    }
+    else if (strcmp(argv[i], "--suggest") == 0 && i + 1 < argc){
+      suggestDistance = atoi(argv[++i]);
+      if (suggestDistance < 1 || suggestDistance > SUGGEST_MAX_DISTANCE){
+        usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc){
+      socketName = argv[++i];
+    }
+    else if (strcmp(argv[i], "--stats") == 0){
+      stats = 1;
+    }
+    else if (strcmp(argv[i], "--profile") == 0){
+      profile = 1;
+    }
+    else if (strcmp(argv[i], "--profile-json") == 0){
+      profile = 2;
+    }
+    else if (strcmp(argv[i], "--image") == 0){
+      image = 1;
+    }
+    else if (strcmp(argv[i], "--write-image") == 0 && i + 1 < argc){
+      imageName = argv[++i];
+    }
+    else if (strncmp(argv[i], "--", 2) == 0 || dictName != NULL){
+      usage(argv[0]);
+    }
+    else{
+      dictName = argv[i];
+    }
+  }
+  if (dictName == NULL){
+    usage(argv[0]);
+  }
+  // the image and the batched lookups only know the three probes
+  if (singleProbe && (image || imageName != NULL || batch || perfectHash)){
+    usage(argv[0]);
+  }
+  // the image keeps no word list to index, the batches print no suggestions
+  if (suggestDistance > 0 && (image || batch)){
+    usage(argv[0]);
+  }
+  // the DAWG is walked a letter at a time, there is no key to hash
+  if (useDawg && (image || imageName != NULL || batch || perfectHash || bloomRate > 0 || singleProbe)){
+    usage(argv[0]);
+  }
+  if (image && (perfectHash || bloomRate > 0)){
+    usage(argv[0]);
+  }
+
+  PROFILE(profiling = profile);
+  PROFILE(double started = profileStart());
+
+  // map the prebuilt dictionary, or make it from the word list
+  if (image){
+    dictionaryImage = openDictionaryImage(dictName, stringHash);
+    if (dictionaryImage == NULL){
+      fprintf(stderr, "Not a dictionary image\n");
+      exit(0);
+    }
+  }
+  else{
+    tableFlags = flags;
+    readDictionary(dictName);
+  }
+  char **words = mappedDictionary != NULL ? mappedDictionary->words : dictionaryWords;
+  int count = mappedDictionary != NULL ? mappedDictionary->count : dictionaryWordCount;
+
+  // build the perfect hash over the words readDictionary collected
+  if (perfectHash){
+    perfectDictionary = createPerfectHashTable(words, (void **) words, count);
+    if (perfectDictionary == NULL){
+      fprintf(stderr, "Could not build a perfect hash of the dictionary\n");
+      exit(0);
+    }
+  }
+
+  // or the DAWG
+  if (useDawg){
+    dawgDictionary = createDawg(words, count);
+    if (dawgDictionary == NULL){
+      fprintf(stderr, "The dictionary is too large for a DAWG\n");
+      exit(0);
+    }
+  }
+
+  PROFILE(profileStop(PHASE_LOAD, started));
+  PROFILE(started = profileStart());
+
+  // write the image and stop there
+  if (imageName != NULL){
+    if (image || writeDictionaryImage(imageName, words, count, stringHash) != 0){
+      fprintf(stderr, "Could not write the dictionary image\n");
+    }
+    stats = 0;
+  }
+
+  // serve documents until stopped, checking them in blocks
+  else if (socketName != NULL){
+    // rehash now rather than during the first requests
+    if (dictionary != NULL){
+      finishResize(dictionary);
+    }
+    serveRequests(socketName);
+  }
 
   // run processInput
-  processInput();
+  else if (threads > 0){
+    // the threads share the dictionary, findData must not change it
+    if (dictionary != NULL){
+      finishResize(dictionary);
+    }
+    processInputThreaded(threads);
+  }
+  else if (block || singleProbe || useDawg || suggestDistance > 0){
+    processInputBlocked();
+  }
+  else if (batch){
+    processInputBatched();
+  }
+  else{
+    processInput();
+  }
+#ifdef PHILSPEL_PROFILE
+  // what stdout still holds is part of the check as well
+  if (profile){
+    double flushed = profileStart();
+    fflush(stdout);
+    profileStop(PHASE_OUTPUT, flushed);
+  }
+  profileStop(PHASE_CHECK, started);
+#endif
+
+  if (profile){
+#ifdef PHILSPEL_PROFILE
+    printProfile(dictionary, profile == 2, stderr);
+#else
+    fprintf(stderr, "phase timing and counters: not built in "
+                    "(compile philspel.c with -DPHILSPEL_PROFILE)\n");
+#endif
+  }
 
-  // free the dictionary
-  freeTable(dictionary);
+  if (stats){
+    fflush(stdout);
+    if (dictionaryImage != NULL){
+      printDictionaryImageStats(dictionaryImage, stderr);
+    }
+    else if (perfectDictionary != NULL){
+      printPerfectHashStats(perfectDictionary, stderr);
+    }
+    else if (dawgDictionary != NULL){
+      printDawgStats(dawgDictionary, stderr);
+    }
+    else{
+      printHashTableStats(dictionary, stderr);
+    }
+    if (bloomFilter != NULL){
+      printBloomFilterStats(bloomFilter, count, stderr);
+    }
+    if (suggestionIndex != NULL){
+      printSuggestionIndexStats(suggestionIndex, stderr);
+    }
+  }
+
+  // free the dictionary and the words in it
+  if (dictionaryImage != NULL){
+    closeDictionaryImage(dictionaryImage);
+  }
+  else{
+    freeTable(dictionary);
+  }
+  if (perfectDictionary != NULL){
+    freePerfectHashTable(perfectDictionary);
+  }
+  if (dawgDictionary != NULL){
+    freeDawg(dawgDictionary);
+  }
+  if (bloomFilter != NULL){
+    freeBloomFilter(bloomFilter);
+  }
+  if (suggestionIndex != NULL){
+    freeSuggestionIndex(suggestionIndex);
+  }
+  for (i = 0; i < dictionaryWordCount; i++){
+    free(dictionaryWords[i]);
+  }
+  free(dictionaryWords);
+  if (mappedDictionary != NULL){
+    unmapWordList(mappedDictionary);
+  }
+  while (foldedWords != NULL){
+    struct FoldedWord *next = foldedWords->next;
+    for (i = 0; i < foldedWords->exactCount; i++){
+      free(foldedWords->exact[i]);
+    }
+    free(foldedWords->exact);
+    free(foldedWords);
+    foldedWords = next;
+  }
   return 0;
 }
 
+/*
+ * findWord for a word whose stringHash is already known.
+ */
+static void *findWordHashed(char *word, unsigned int hash) {
+  void *found;
+
+  if (bloomFilter != NULL && !bloomFilterMayContain(bloomFilter, hash)){
+    found = NULL;
+  }
+  else if (dictionaryImage != NULL){
+    found = findImageDataHashed(dictionaryImage, word, hash);
+  }
+  else if (perfectDictionary != NULL){
+    found = findPerfectData(perfectDictionary, word);
+  }
+  else{
+    found = findDataHashed(dictionary, word, hash);
+  }
+  PROFILE(profileLookup(found != NULL));
+  return found;
+}
+
+/*
+ * look word up in whichever dictionary was loaded.
+ */
+static void *findWord(char *word) {
+  void *found;
+
+  if (bloomFilter != NULL && !bloomFilterMayContain(bloomFilter, stringHash(word))){
+    found = NULL;
+  }
+  else if (dictionaryImage != NULL){
+    found = findImageData(dictionaryImage, word);
+  }
+  else if (perfectDictionary != NULL){
+    found = findPerfectData(perfectDictionary, word);
+  }
+  else{
+    found = findData(dictionary, word);
+  }
+  PROFILE(profileLookup(found != NULL));
+  return found;
+}
+
 /*
  * You need to define this function. void *s can be safely casted
  * to a char * (NULL terminated string) which is done for you here for
@@ -63,15 +528,9 @@ int main(int argc, char **argv) {
 unsigned int stringHash(void *s) {
   char *string = (char *)s;
 
-  // credit to djb2 by Daniel J. Bernstein for this hash function from 1991
-  unsigned long hash = 5381;
-  int c;
-
-  while ((c = *string++)){
-    hash = ((hash << 5) + hash) + c;
-  }
-
-  return hash;
+  // eight bytes at a time, see wordhash.h (this used to be djb2, one byte
+  // at a time, and the block path hashes words without strlen)
+  return wordHash(string, strlen(string));
 }
 
 /*
@@ -93,6 +552,157 @@ int stringEquals(void *s1, void *s2) {
   }
 }
 
+/*
+ * with --bloom, fill the Bloom filter with the keys readDictionary put in
+ * the dictionary.
+ */
+static void buildBloomFilter() {
+  char **words = mappedDictionary != NULL ? mappedDictionary->words : dictionaryWords;
+  int count = mappedDictionary != NULL ? mappedDictionary->count : dictionaryWordCount;
+  struct FoldedWord *entry;
+  int i;
+
+  if (bloomRate == 0){
+    return;
+  }
+  bloomFilter = createBloomFilter(count, bloomRate);
+  if (singleProbe){
+    for (entry = foldedWords; entry != NULL; entry = entry->next){
+      addToBloomFilter(bloomFilter, stringHash(entry->word));
+    }
+  }
+  else{
+    for (i = 0; i < count; i++){
+      addToBloomFilter(bloomFilter, stringHash(words[i]));
+    }
+  }
+}
+
+/*
+ * with --suggest, build the suggestion index over the words readDictionary
+ * read.
+ */
+static void buildSuggestionIndex() {
+  char **words = mappedDictionary != NULL ? mappedDictionary->words : dictionaryWords;
+  int count = mappedDictionary != NULL ? mappedDictionary->count : dictionaryWordCount;
+
+  if (suggestDistance == 0){
+    return;
+  }
+  suggestionIndex = createSuggestionIndex(words, count, suggestDistance);
+}
+
+/*
+ * add a dictionary word to the case folded dictionary, creating the entry
+ * for its lowercase form if it is the first spelling of it.
+ */
+static void addFoldedWord(char *word) {
+  size_t length = strlen(word);
+  struct FoldedWord *entry;
+  char *lower = malloc((length + 1)*sizeof(char));
+  int restLower = 1;
+  size_t j;
+
+  for (j = 0; j <= length; j++){
+    lower[j] = tolower((unsigned char) word[j]);
+    if (j > 0 && lower[j] != word[j]){
+      restLower = 0;
+    }
+  }
+  entry = findData(dictionary, lower);
+  free(lower);
+  if (entry == NULL){
+    entry = calloc(1, sizeof(struct FoldedWord) + length + 1);
+    for (j = 0; j <= length; j++){
+      entry->word[j] = tolower((unsigned char) word[j]);
+    }
+    entry->next = foldedWords;
+    foldedWords = entry;
+    insertData(dictionary, entry->word, entry);
+  }
+
+  if (restLower && entry->word[0] == word[0]){
+    entry->accepts |= FOLD_ANY;
+  }
+  else if (restLower && isupper((unsigned char) word[0])){
+    entry->accepts |= FOLD_CAPITAL;
+  }
+  else{
+    entry->exact = realloc(entry->exact, (entry->exactCount + 1)*sizeof(char *));
+    entry->exact[entry->exactCount] = malloc((length + 1)*sizeof(char));
+    strcpy(entry->exact[entry->exactCount++], word);
+  }
+}
+
+/*
+ * check the word of length letters at word in the case folded
+ * dictionary: one lookup of its lowercase form, then see whether that
+ * entry accepts this spelling.  Gives the same answer as the three
+ * lookups processInput makes in the plain dictionary.
+ */
+static int checkFoldedWord(const char *word, size_t length) {
+  char shortWord[64];
+  char *lower = length < sizeof(shortWord) ? shortWord : malloc((length + 1)*sizeof(char));
+  struct FoldedWord *entry;
+  int known = 0;
+  size_t j;
+
+  for (j = 0; j < length; j++){
+    lower[j] = tolower((unsigned char) word[j]);
+  }
+  lower[length] = '\0';
+  if (bloomFilter != NULL && !bloomFilterMayContain(bloomFilter, stringHash(lower))){
+    entry = NULL;
+  }
+  else{
+    entry = findData(dictionary, lower);
+  }
+  PROFILE(profileLookup(entry != NULL));
+
+  if (entry != NULL){
+    if (entry->accepts & FOLD_ANY){
+      known = 1;
+    }
+    else if ((entry->accepts & FOLD_CAPITAL) && isupper((unsigned char) word[0])){
+      known = 1;
+    }
+    for (j = 0; !known && j < (size_t) entry->exactCount; j++){
+      known = strncmp(entry->exact[j], word, length) == 0 && entry->exact[j][length] == '\0';
+    }
+  }
+  if (lower != shortWord){
+    free(lower);
+  }
+  return known;
+}
+
+/*
+ * put the count words readDictionary read into the dictionary.  It is
+ * built in one go with buildHashTable, sized for all of them and on every
+ * processor, except with --single-probe, whose entries merge the
+ * spellings of a word as they are added, and with --perfect and --dawg,
+ * which leave it empty.
+ */
+static void fillDictionary(char **words, int count) {
+  int i;
+
+  if (singleProbe){
+    dictionary = createHashTableWithFlags(count > 0 ? count : 1, stringHash, stringEquals, tableFlags);
+    for (i = 0; i < count; i++){
+      addFoldedWord(words[i]);
+    }
+  }
+  else if (perfectHash || useDawg){
+    dictionary = createHashTableWithFlags(1, stringHash, stringEquals, tableFlags);
+  }
+  else{
+    dictionary = buildHashTable((void **) words, (void **) words, count, stringHash, stringEquals,
+                                tableFlags, sysconf(_SC_NPROCESSORS_ONLN));
+  }
+  buildBloomFilter();
+  buildSuggestionIndex();
+}
+
 /*
  * this function should read in every word in the dictionary and
  * store it in the dictionary.  You should first open the file specified,
@@ -114,6 +724,15 @@ void readDictionary(char *filename) {
   FILE *f;
   char *store;
   char *temp;
+
+  // map the file and use its words without copying them, if possible
+  mappedDictionary = mapWordList(filename);
+  if (mappedDictionary != NULL){
+    fillDictionary(mappedDictionary->words, mappedDictionary->count);
+    return;
+  }
+
+  // otherwise (a pipe, say) read it a word at a time
   store = (char*) malloc(9999*sizeof(char));
 
   // open the file
@@ -132,8 +751,12 @@ void readDictionary(char *filename) {
     // make a copy to be inserted into the dictionary
     temp = (char *)malloc(2*strlen(store)*sizeof(char));
     strcpy(temp, store);
-    // add the key/value pair to the dictionary
-    insertData(dictionary, temp, temp);
+    // remember the copy so main can free it
+    if (dictionaryWordCount == dictionaryWordCapacity){
+      dictionaryWordCapacity = 2*dictionaryWordCapacity + 16;
+      dictionaryWords = realloc(dictionaryWords, dictionaryWordCapacity*sizeof(char *));
+    }
+    dictionaryWords[dictionaryWordCount++] = temp;
   }
 
   // free memory
@@ -141,6 +764,9 @@ void readDictionary(char *filename) {
 
   // close the file
   fclose(f);
+
+  // now that the words are counted, add them all at once
+  fillDictionary(dictionaryWords, dictionaryWordCount);
 }
 
 /*
@@ -180,6 +806,7 @@ void processInput() {
 
   // while there are characters in standard input
   while ((cha = getchar()) != EOF){
+    PROFILE(profileCounters.bytesIn++);
     // check if the character is non-alphabetic
     if (!isalpha(cha)){
         // check if there is anything in the character array
@@ -188,9 +815,11 @@ void processInput() {
           arr[i] = '\0';
           // print the word
           printf("%s", arr);
+          PROFILE(profileCounters.bytesOut += i);
+          PROFILE(double started = profileStartWord());
 
           // check if the word is in the dictionary
-          if (findData(dictionary, arr) != NULL){
+          if (findWord(arr) != NULL){
             k++;
           }
 
@@ -198,15 +827,16 @@ void processInput() {
           for (int j = 1; arr[j] != '\0';j++){
             arr[j] = tolower(arr[j]);
           }
-          if (findData(dictionary, arr) != NULL){
+          if (findWord(arr) != NULL){
             k++;
           }
 
           // change the first letter to lowercase as well and check again
           arr[0] = tolower(arr[0]);
-          if (findData(dictionary, arr) != NULL){
+          if (findWord(arr) != NULL){
             k++;
           }
+          PROFILE(profileStopWords(started, 1));
         }
 
 		// check if k fulfills any conditions
@@ -218,11 +848,14 @@ void processInput() {
         // otherwise if there is something in the array, print out the word with " [sic]" and empty the array
         else if (k == 0 && i > 0){
             printf("%s", " [sic]");
+            PROFILE(profileCounters.bytesOut += 6);
+            PROFILE(profileCounters.unknownWords++);
             memset(arr, 0, strlen(arr));
         }
 
         // print the character
         printf("%c", (char) cha);
+        PROFILE(profileCounters.bytesOut++);
 
         // reset the index
         capacity = 61;
@@ -251,9 +884,11 @@ void processInput() {
   arr[i] = '\0';
   // print the word
   printf("%s", arr);
+  PROFILE(profileCounters.bytesOut += i);
+  PROFILE(double started = profileStartWord());
 
   // check if the word is in the dictionary
-  if (findData(dictionary, arr) != NULL){
+  if (findWord(arr) != NULL){
     k++;
   }
 
@@ -261,21 +896,930 @@ void processInput() {
   for (int j = 1; arr[j] != '\0';j++){
     arr[j] = tolower(arr[j]);
   }
-  if (findData(dictionary, arr) != NULL){
+  if (findWord(arr) != NULL){
     k++;
   }
 
   // change the first letter to lowercase as well and check again
   arr[0] = tolower(arr[0]);
-  if (findData(dictionary, arr) != NULL){
+  if (findWord(arr) != NULL){
     k++;
   }
 
   // if there is something in the array, print out the word with " [sic]"
   else if (k == 0 && i > 0){
     printf("%s", " [sic]");
+    PROFILE(profileCounters.bytesOut += 6);
+    PROFILE(profileCounters.unknownWords++);
   }
+  PROFILE(profileStopWords(started, i > 0));
 
   // free memory
   free(arr);
-}
\ No newline at end of file
+}
+
+/*
+ * how many words processInputBatched looks up with each findDataBatch.
+ */
+#define WORD_BATCH 64
+
+/*
+ * the input read since the last flush, and where the complete words in
+ * it start and end.
+ */
+static char *pendingText;
+static int pendingLength;
+static int pendingCapacity;
+static int wordStart[WORD_BATCH];
+static int wordEnd[WORD_BATCH];
+static int wordCount;
+
+/*
+ * findWord for n words at once, batched where the dictionary can batch.
+ * The words the Bloom filter rejects are left out of the batch.
+ */
+static void findWords(void **keys, void **found, int n) {
+  void *passed[WORD_BATCH];
+  void *results[WORD_BATCH];
+  unsigned int hashes[WORD_BATCH];
+  int index[WORD_BATCH];
+  int count = 0;
+  int j;
+
+  // with a Bloom filter every word is hashed here already, and the
+  // lookups reuse those hashes
+  for (j = 0; j < n; j++){
+    found[j] = NULL;
+    if (bloomFilter == NULL){
+      index[count] = j;
+      passed[count++] = keys[j];
+    }
+    else{
+      unsigned int hash = stringHash(keys[j]);
+      if (bloomFilterMayContain(bloomFilter, hash)){
+        index[count] = j;
+        hashes[count] = hash;
+        passed[count++] = keys[j];
+      }
+    }
+  }
+  if (dictionaryImage != NULL){
+    findImageDataBatch(dictionaryImage, passed, results, count);
+  }
+  else if (perfectDictionary != NULL){
+    for (j = 0; j < count; j++){
+      results[j] = findPerfectData(perfectDictionary, passed[j]);
+    }
+  }
+  else{
+    findDataBatchHashed(dictionary, passed, bloomFilter != NULL ? hashes : NULL, results, count);
+  }
+  for (j = 0; j < count; j++){
+    found[index[j]] = results[j];
+  }
+  PROFILE(for (j = 0; j < n; j++) profileLookup(found[j] != NULL));
+}
+
+/*
+ * append one character to the pending text.
+ */
+static void appendPending(char c) {
+  if (pendingLength == pendingCapacity){
+    pendingCapacity = 2*pendingCapacity + 256;
+    pendingText = realloc(pendingText, pendingCapacity*sizeof(char));
+  }
+  pendingText[pendingLength++] = c;
+}
+
+/*
+ * check the pending words three lookups at a time, the same three
+ * spellings processInput tries (as is, all but the first letter
+ * lowercased, all lowercased), then print the pending text with " [sic]"
+ * after the words none of them matched.
+ */
+static void flushPending() {
+  static char *scratch;
+  static int scratchCapacity;
+  void *keys[WORD_BATCH];
+  void *found[WORD_BATCH];
+  int waiting[WORD_BATCH];
+  int known[WORD_BATCH];
+  int offset[WORD_BATCH];
+  int needed = 0;
+  int printed = 0;
+  int probe, j, n;
+
+  // copy every word, NUL terminated, to the scratch buffer
+  for (j = 0; j < wordCount; j++){
+    needed += wordEnd[j] - wordStart[j] + 1;
+  }
+  if (needed > scratchCapacity){
+    scratchCapacity = needed;
+    scratch = realloc(scratch, scratchCapacity*sizeof(char));
+  }
+  needed = 0;
+  for (j = 0; j < wordCount; j++){
+    offset[j] = needed;
+    memcpy(scratch + needed, pendingText + wordStart[j], wordEnd[j] - wordStart[j]);
+    needed += wordEnd[j] - wordStart[j];
+    scratch[needed++] = '\0';
+    known[j] = 0;
+    waiting[j] = j;
+  }
+
+  // each probe only looks up the words the previous ones did not find
+  PROFILE(double started = profileStart());
+  n = wordCount;
+  for (probe = 0; probe < 3 && n > 0; probe++){
+    for (j = 0; j < n; j++){
+      char *word = scratch + offset[waiting[j]];
+      if (probe == 1){
+        for (int c = 1; word[c] != '\0'; c++){
+          word[c] = tolower(word[c]);
+        }
+      }
+      else if (probe == 2){
+        word[0] = tolower(word[0]);
+      }
+      keys[j] = word;
+    }
+    findWords(keys, found, n);
+    needed = 0;
+    for (j = 0; j < n; j++){
+      if (found[j] != NULL){
+        known[waiting[j]] = 1;
+      }
+      else{
+        waiting[needed++] = waiting[j];
+      }
+    }
+    n = needed;
+  }
+  PROFILE(profileStopWords(started, wordCount));
+
+  // print the text, marking the unknown words
+  PROFILE(started = profileStart());
+  for (j = 0; j < wordCount; j++){
+    fwrite(pendingText + printed, sizeof(char), wordEnd[j] - printed, stdout);
+    printed = wordEnd[j];
+    if (!known[j]){
+      printf("%s", " [sic]");
+      PROFILE(profileCounters.bytesOut += 6);
+      PROFILE(profileCounters.unknownWords++);
+    }
+  }
+  fwrite(pendingText + printed, sizeof(char), pendingLength - printed, stdout);
+  PROFILE(profileCounters.bytesOut += pendingLength);
+  PROFILE(profileStop(PHASE_OUTPUT, started));
+  pendingLength = 0;
+  wordCount = 0;
+}
+
+/*
+ * the same as processInput, but the words are collected WORD_BATCH at a
+ * time and looked up with findDataBatch, so the dictionary lookups of
+ * neighbouring words overlap.
+ */
+void processInputBatched() {
+  int cha;
+  int inWord = 0;
+
+  while ((cha = getchar()) != EOF){
+    PROFILE(profileCounters.bytesIn++);
+    if (isalpha(cha)){
+      // start a new word if this is its first letter
+      if (!inWord){
+        wordStart[wordCount] = pendingLength;
+        inWord = 1;
+      }
+      appendPending((char) cha);
+    }
+    else{
+      // a non-alphabetic character ends the current word
+      if (inWord){
+        wordEnd[wordCount++] = pendingLength;
+        inWord = 0;
+      }
+      appendPending((char) cha);
+      if (wordCount == WORD_BATCH){
+        flushPending();
+      }
+    }
+  }
+
+  // the input may end in the middle of a word
+  if (inWord){
+    wordEnd[wordCount++] = pendingLength;
+  }
+  flushPending();
+  free(pendingText);
+}
+
+/*
+ * how much input processInputBlocked reads at a time, and how much
+ * output it collects before writing it out.
+ */
+#define BLOCK_SIZE 65536
+
+/*
+ * output collected in memory.  With a file it is written out whenever it
+ * fills up, without one it grows to hold everything.
+ */
+struct OutputBuffer {
+  char *data;
+  size_t length;
+  size_t capacity;
+  FILE *file;
+};
+
+/*
+ * add length bytes of text to the output.
+ */
+static void appendOutput(struct OutputBuffer *out, const char *text, size_t length) {
+  PROFILE(profileCounters.bytesOut += length);
+  if (out->length + length > out->capacity){
+    if (out->file != NULL){
+      PROFILE(double started = profileStart());
+      fwrite(out->data, sizeof(char), out->length, out->file);
+      out->length = 0;
+      // too big to be worth buffering, write it straight through
+      if (length > out->capacity){
+        fwrite(text, sizeof(char), length, out->file);
+        PROFILE(profileStop(PHASE_OUTPUT, started));
+        return;
+      }
+      PROFILE(profileStop(PHASE_OUTPUT, started));
+    }
+    else{
+      while (out->length + length > out->capacity){
+        out->capacity = 2*out->capacity + BLOCK_SIZE;
+      }
+      out->data = realloc(out->data, out->capacity*sizeof(char));
+    }
+  }
+  memcpy(out->data + out->length, text, length);
+  out->length += length;
+}
+
+/*
+ * check the word of length letters at word in the DAWG, following the
+ * three spellings processInput tries (as is, all but the first letter
+ * lowercased, all lowercased) side by side in one pass over the word.
+ */
+static int checkDawgWord(const char *word, size_t length) {
+  unsigned char first = word[0];
+  uint32_t asIs = dawgStep(dawgDictionary, DAWG_START, first);
+  uint32_t capitalized = asIs;
+  uint32_t lower = dawgStep(dawgDictionary, DAWG_START, tolower(first));
+  int known;
+  size_t j;
+
+  for (j = 1; j < length; j++){
+    unsigned char c = word[j];
+    unsigned char folded = tolower(c);
+    if ((asIs | capitalized | lower) == DAWG_DEAD){
+      PROFILE(profileLookup(0));
+      return 0;
+    }
+    asIs = dawgStep(dawgDictionary, asIs, c);
+    capitalized = dawgStep(dawgDictionary, capitalized, folded);
+    lower = dawgStep(dawgDictionary, lower, folded);
+  }
+  known = dawgIsWord(dawgDictionary, asIs) || dawgIsWord(dawgDictionary, capitalized) ||
+          dawgIsWord(dawgDictionary, lower);
+  PROFILE(profileLookup(known));
+  return known;
+}
+
+/*
+ * the stringHash of the three spellings processInput tries of the word of
+ * length letters at word (as is, all but the first letter lowercased, all
+ * lowercased), in one pass over the word eight bytes at a time.  The same
+ * pass writes the all lowercase spelling, NUL terminated, to lowered,
+ * which needs room for length + 8 bytes.  Returns 1 if the second
+ * spelling is the word as is, plus 2 if the third is the second.
+ *
+ * Every byte of a word is a letter, so ORing in 0x20 lowercases it, and
+ * that can be done to a whole chunk at once.
+ */
+static int hashWordSpellings(const char *word, size_t length, unsigned int *hashes, char *lowered) {
+  const uint64_t lowercase = 0x2020202020202020ULL;
+  uint64_t asIs = WORDHASH_SEED;
+  uint64_t capitalized = WORDHASH_SEED;
+  uint64_t lower = WORDHASH_SEED;
+  uint64_t chunk, folded, capital;
+  uint64_t restChanged = 0;
+  size_t at;
+
+  for (at = 0; at < length; at += 8){
+    size_t count = length - at < 8 ? length - at : 8;
+    chunk = count == 8 ? wordHashLoad(word + at) : wordHashTail(word + at, count, length);
+    folded = chunk | (lowercase >> (64 - 8*count));
+    capital = at == 0 ? (folded & ~0xffULL) | (chunk & 0xff) : folded;
+    restChanged |= capital ^ chunk;
+    wordHashStore(lowered + at, folded);
+    asIs = wordHashStep(asIs, chunk);
+    capitalized = wordHashStep(capitalized, capital);
+    lower = wordHashStep(lower, folded);
+  }
+  lowered[length] = '\0';
+  hashes[0] = wordHashFinish(asIs, length);
+  hashes[1] = wordHashFinish(capitalized, length);
+  hashes[2] = wordHashFinish(lower, length);
+  return (restChanged == 0) | (word[0] == lowered[0]) << 1;
+}
+
+/*
+ * check the word of length letters at word with the same three lookups
+ * processInput does, hashing all three spellings in a single pass (and
+ * skipping the lookups of spellings that are the same as the one before).
+ * The byte after the word is used for the terminator while looking it up,
+ * and put back.
+ */
+static int checkWordInPlace(char *word, size_t length) {
+  char shortWord[64 + 8];
+  char *lowered;
+  unsigned int hashes[3];
+  char after = word[length];
+  int same;
+  int known = 0;
+
+  if (singleProbe){
+    return checkFoldedWord(word, length);
+  }
+  if (dawgDictionary != NULL){
+    return checkDawgWord(word, length);
+  }
+  lowered = length + 8 <= sizeof(shortWord) ? shortWord : malloc((length + 8)*sizeof(char));
+  same = hashWordSpellings(word, length, hashes, lowered);
+
+  word[length] = '\0';
+  known = findWordHashed(word, hashes[0]) != NULL;
+  word[length] = after;
+  if (!known && !(same & 1)){
+    // all but the first letter lowercase
+    char first = lowered[0];
+    lowered[0] = word[0];
+    known = findWordHashed(lowered, hashes[1]) != NULL;
+    lowered[0] = first;
+  }
+  if (!known && !(same & 2)){
+    // and the first letter as well
+    known = findWordHashed(lowered, hashes[2]) != NULL;
+  }
+  if (lowered != shortWord){
+    free(lowered);
+  }
+  return known;
+}
+
+/*
+ * append the suggestions for an unknown word, " (first, second, ...)".
+ * If the word is capitalized, so are the all lowercase suggestions (which
+ * the dictionary accepts either way).  Nothing if there are none.
+ */
+static void appendSuggestions(const char *word, size_t length, int capital, struct OutputBuffer *out) {
+  const char *suggestions[SUGGESTIONS];
+  int found = findSuggestions(suggestionIndex, word, length, suggestions, SUGGESTIONS);
+  int i, j;
+
+  for (i = 0; i < found; i++){
+    char first = suggestions[i][0];
+    if (capital){
+      for (j = 0; suggestions[i][j] != '\0' && !isupper((unsigned char) suggestions[i][j]); j++){
+      }
+      if (suggestions[i][j] == '\0'){
+        first = toupper((unsigned char) first);
+      }
+    }
+    appendOutput(out, i == 0 ? " (" : ", ", 2);
+    appendOutput(out, &first, 1);
+    appendOutput(out, suggestions[i] + 1, strlen(suggestions[i] + 1));
+  }
+  if (found > 0){
+    appendOutput(out, ")", 1);
+  }
+}
+
+/*
+ * copy a word to the output, followed by " [sic]" if it is not in the
+ * dictionary (and with --suggest, by what it may have meant).
+ */
+static void finishWord(char *word, size_t length, struct OutputBuffer *out) {
+  int known;
+
+  appendOutput(out, word, length);
+  PROFILE(double started = profileStartWord());
+  known = checkWordInPlace(word, length);
+  PROFILE(profileStopWords(started, 1));
+  if (!known){
+    PROFILE(profileCounters.unknownWords++);
+    appendOutput(out, " [sic]", 6);
+    if (suggestionIndex != NULL){
+      appendSuggestions(word, length, isupper((unsigned char) word[0]), out);
+    }
+  }
+}
+
+/*
+ * spell check length bytes of text into out.  The text has to end at the
+ * end of a word (or the input), and text[length] has to be writable.
+ * Runs of non-alphabetic characters are copied as they are, each word is
+ * copied and followed by " [sic]" if it is not in the dictionary.
+ *
+ * The text is classified TOKEN_STEP bytes at a time (see tokenize.h), and
+ * only the bytes where a word starts or ends are visited.
+ */
+static void processBlock(char *text, size_t length, struct OutputBuffer *out) {
+  size_t start = 0;
+  size_t base;
+  uint32_t inWord = 0;
+  PROFILE(double started = profileStart());
+  PROFILE(double written = profileCounters.seconds[PHASE_OUTPUT]);
+
+  for (base = 0; base < length; base += TOKEN_STEP){
+    size_t count = length - base < TOKEN_STEP ? length - base : TOKEN_STEP;
+    uint32_t letters = count == TOKEN_STEP ? letterMask(text + base) : letterMaskScalar(text + base, count);
+    uint32_t boundaries = wordStarts(letters, inWord) | wordEnds(letters, inWord);
+    size_t at;
+
+    if (count < 32){
+      boundaries &= (1U << count) - 1;
+    }
+    // each boundary ends the current run of separators or letters
+    while (boundaries != 0){
+      at = base + __builtin_ctz(boundaries);
+      if (inWord){
+        finishWord(text + start, at - start, out);
+      }
+      else{
+        appendOutput(out, text + start, at - start);
+      }
+      inWord ^= 1;
+      start = at;
+      boundaries &= boundaries - 1;
+    }
+  }
+
+  // the last run ends with the text
+  if (inWord){
+    finishWord(text + start, length - start, out);
+  }
+  else{
+    appendOutput(out, text + start, length - start);
+  }
+
+  // without the output that was written out on the way
+  PROFILE(profileStop(PHASE_SCAN, started));
+  PROFILE(profileCounters.seconds[PHASE_SCAN] -= profileCounters.seconds[PHASE_OUTPUT] - written);
+}
+
+/*
+ * the same as processInput, but standard input is read BLOCK_SIZE bytes
+ * at a time and the words are checked where they are in the block.  A
+ * word that runs past the end of the block is kept back and finished
+ * with the next one; the block grows if a single word fills all of it.
+ */
+void processInputBlocked() {
+  struct OutputBuffer out;
+  size_t capacity = BLOCK_SIZE;
+  char *buffer = malloc((capacity + 1)*sizeof(char));
+  size_t filled = 0;
+  size_t end;
+  size_t got;
+
+  out.capacity = BLOCK_SIZE;
+  out.data = malloc(out.capacity*sizeof(char));
+  out.length = 0;
+  out.file = stdout;
+
+  while ((got = fread(buffer + filled, sizeof(char), capacity - filled, stdin)) > 0){
+    filled += got;
+    PROFILE(profileCounters.bytesIn += got);
+
+    // hold back the word at the end, it may go on in the next block
+    end = filled;
+    while (end > 0 && isalpha((unsigned char) buffer[end - 1])){
+      end--;
+    }
+    processBlock(buffer, end, &out);
+    memmove(buffer, buffer + end, filled - end);
+    filled -= end;
+
+    if (filled == capacity){
+      capacity *= 2;
+      buffer = realloc(buffer, (capacity + 1)*sizeof(char));
+    }
+  }
+
+  // the end of the input ends the last word
+  processBlock(buffer, filled, &out);
+  PROFILE(double started = profileStart());
+  fwrite(out.data, sizeof(char), out.length, stdout);
+  PROFILE(profileStop(PHASE_OUTPUT, started));
+  free(out.data);
+  free(buffer);
+}
+
+/*
+ * how much input each chunk of processInputThreaded starts out holding.
+ */
+#define CHUNK_SIZE (1 << 20)
+
+/*
+ * a piece of the input, ending at the end of a word, and its checked
+ * output.
+ */
+struct Chunk {
+  char *text;
+  size_t length;
+  size_t capacity;
+  struct OutputBuffer out;
+  int checked;
+};
+
+/*
+ * the chunks are used round robin.  Chunk number n (counting from the
+ * start of the input) is in chunks[n % chunkCount]; chunks before
+ * chunksFilled have been read in, and chunks before chunksTaken have been
+ * picked up by a thread.  chunkLock protects these counters, inputDone
+ * and the checked flags.
+ */
+static struct Chunk *chunks;
+static int chunkCount;
+static long chunksFilled;
+static long chunksTaken;
+static int inputDone;
+static pthread_mutex_t chunkLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t chunkFilled = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t chunkChecked = PTHREAD_COND_INITIALIZER;
+
+/*
+ * the checking threads: take the next chunk in order and check it into
+ * its own output buffer, until the input runs out.
+ */
+static void *checkChunks(void *unused) {
+  struct Chunk *chunk;
+
+  pthread_mutex_lock(&chunkLock);
+  while (1){
+    while (chunksTaken == chunksFilled && !inputDone){
+      pthread_cond_wait(&chunkFilled, &chunkLock);
+    }
+    if (chunksTaken == chunksFilled){
+      break;
+    }
+    chunk = &chunks[chunksTaken++ % chunkCount];
+    pthread_mutex_unlock(&chunkLock);
+
+    chunk->out.length = 0;
+    processBlock(chunk->text, chunk->length, &chunk->out);
+
+    pthread_mutex_lock(&chunkLock);
+    chunk->checked = 1;
+    pthread_cond_broadcast(&chunkChecked);
+  }
+  pthread_mutex_unlock(&chunkLock);
+  PROFILE(mergeProfileCounters());
+  return NULL;
+}
+
+/*
+ * wait for chunk number n to be checked and write it out.
+ */
+static void writeChunk(long n) {
+  struct Chunk *chunk = &chunks[n % chunkCount];
+
+  pthread_mutex_lock(&chunkLock);
+  while (!chunk->checked){
+    pthread_cond_wait(&chunkChecked, &chunkLock);
+  }
+  pthread_mutex_unlock(&chunkLock);
+  PROFILE(double started = profileStart());
+  fwrite(chunk->out.data, sizeof(char), chunk->out.length, stdout);
+  PROFILE(profileStop(PHASE_OUTPUT, started));
+}
+
+/*
+ * the same as processInputBlocked, but the blocks (chunks) are checked
+ * by threads threads at once while this thread reads the input and
+ * writes the checked chunks out in their original order.  Twice as many
+ * chunks as threads are in flight, so the threads do not wait for the
+ * reading and writing.
+ */
+void processInputThreaded(int threads) {
+  pthread_t *workers = malloc(threads*sizeof(pthread_t));
+  char *carry = NULL;
+  size_t carryLength = 0;
+  size_t carryCapacity = 0;
+  long chunksWritten = 0;
+  int started = threads;
+  int atEnd = 0;
+  int i;
+
+  chunkCount = 2*threads;
+  chunks = calloc(chunkCount, sizeof(struct Chunk));
+  for (i = 0; i < chunkCount; i++){
+    chunks[i].capacity = CHUNK_SIZE;
+    chunks[i].text = malloc((chunks[i].capacity + 1)*sizeof(char));
+  }
+  for (i = 0; i < threads; i++){
+    if (pthread_create(&workers[i], NULL, checkChunks, NULL) != 0){
+      break;
+    }
+  }
+
+  // nothing has been read yet, so if a thread did not start, stop the
+  // ones that did and check the input on this thread instead
+  if (i < threads){
+    fprintf(stderr, "Could not start %d checking threads, checking without them\n", threads);
+    pthread_mutex_lock(&chunkLock);
+    inputDone = 1;
+    pthread_cond_broadcast(&chunkFilled);
+    pthread_mutex_unlock(&chunkLock);
+    started = i;
+    atEnd = 1;
+  }
+
+  while (!atEnd){
+    struct Chunk *chunk = &chunks[chunksFilled % chunkCount];
+    size_t filled = carryLength;
+    size_t end;
+
+    // the chunk is free again once the one that used it is written
+    if (chunksFilled - chunksWritten == chunkCount){
+      writeChunk(chunksWritten++);
+    }
+
+    // start with the word the last chunk ended in the middle of
+    if (carryLength >= chunk->capacity){
+      chunk->capacity = 2*carryLength;
+      chunk->text = realloc(chunk->text, (chunk->capacity + 1)*sizeof(char));
+    }
+    memcpy(chunk->text, carry, carryLength);
+
+    // read until the chunk is full, and has a word boundary in it
+    while (1){
+      size_t got = fread(chunk->text + filled, sizeof(char), chunk->capacity - filled, stdin);
+      filled += got;
+      PROFILE(profileCounters.bytesIn += got);
+      if (filled < chunk->capacity){
+        atEnd = 1;
+        end = filled;
+        break;
+      }
+      end = filled;
+      while (end > 0 && isalpha((unsigned char) chunk->text[end - 1])){
+        end--;
+      }
+      if (end > 0){
+        break;
+      }
+      chunk->capacity *= 2;
+      chunk->text = realloc(chunk->text, (chunk->capacity + 1)*sizeof(char));
+    }
+
+    // keep back the unfinished word for the next chunk
+    carryLength = filled - end;
+    if (carryLength > carryCapacity){
+      carryCapacity = 2*carryLength;
+      carry = realloc(carry, carryCapacity*sizeof(char));
+    }
+    memcpy(carry, chunk->text + end, carryLength);
+
+    chunk->length = end;
+    chunk->checked = 0;
+    pthread_mutex_lock(&chunkLock);
+    chunksFilled++;
+    pthread_cond_signal(&chunkFilled);
+    pthread_mutex_unlock(&chunkLock);
+  }
+
+  pthread_mutex_lock(&chunkLock);
+  inputDone = 1;
+  pthread_cond_broadcast(&chunkFilled);
+  pthread_mutex_unlock(&chunkLock);
+  while (chunksWritten < chunksFilled){
+    writeChunk(chunksWritten++);
+  }
+
+  for (i = 0; i < started; i++){
+    pthread_join(workers[i], NULL);
+  }
+  for (i = 0; i < chunkCount; i++){
+    free(chunks[i].text);
+    free(chunks[i].out.data);
+  }
+  free(chunks);
+  free(carry);
+  free(workers);
+  if (started < threads){
+    processInputBlocked();
+  }
+}
+
+/*
+ * a client of serveRequests: the part of its document read so far that
+ * has not been checked yet, and the checked output not yet sent back.
+ */
+struct Connection {
+  struct Connection *next;
+  struct Connection *previous;
+  int fd;
+  char *text;
+  size_t length;
+  size_t capacity;
+  struct OutputBuffer out;
+  size_t sent;
+  int readAll;
+};
+
+/*
+ * the open connections, so they can be closed when the server stops.
+ */
+static struct Connection *connections;
+
+/*
+ * set by SIGINT and SIGTERM to stop serveRequests.
+ */
+static volatile sig_atomic_t stopServing;
+
+static void stopServer(int number) {
+  stopServing = 1;
+}
+
+static void closeConnection(int epoll, struct Connection *connection) {
+  if (connection->previous != NULL){
+    connection->previous->next = connection->next;
+  }
+  else{
+    connections = connection->next;
+  }
+  if (connection->next != NULL){
+    connection->next->previous = connection->previous;
+  }
+  epoll_ctl(epoll, EPOLL_CTL_DEL, connection->fd, NULL);
+  close(connection->fd);
+  free(connection->text);
+  free(connection->out.data);
+  free(connection);
+}
+
+/*
+ * read what the client has sent and check the words that are complete.
+ * Returns 0 if the connection failed.
+ */
+static int readRequest(struct Connection *connection) {
+  ssize_t got;
+  size_t end;
+
+  while (!connection->readAll){
+    if (connection->length == connection->capacity){
+      connection->capacity *= 2;
+      connection->text = realloc(connection->text, (connection->capacity + 1)*sizeof(char));
+    }
+    got = read(connection->fd, connection->text + connection->length, connection->capacity - connection->length);
+    if (got < 0){
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (got == 0){
+      // the end of the document ends the last word
+      connection->readAll = 1;
+      processBlock(connection->text, connection->length, &connection->out);
+      connection->length = 0;
+      break;
+    }
+    connection->length += got;
+    PROFILE(profileCounters.bytesIn += got);
+
+    // hold back the word at the end, like processInputBlocked
+    end = connection->length;
+    while (end > 0 && isalpha((unsigned char) connection->text[end - 1])){
+      end--;
+    }
+    processBlock(connection->text, end, &connection->out);
+    memmove(connection->text, connection->text + end, connection->length - end);
+    connection->length -= end;
+  }
+  return 1;
+}
+
+/*
+ * send as much of the checked output as the client takes.  Returns 0 if
+ * the connection failed.
+ */
+static int writeResponse(struct Connection *connection) {
+  ssize_t put;
+  PROFILE(double started = profileStart());
+
+  while (connection->sent < connection->out.length){
+    put = send(connection->fd, connection->out.data + connection->sent, connection->out.length - connection->sent, MSG_NOSIGNAL);
+    if (put < 0){
+      PROFILE(profileStop(PHASE_OUTPUT, started));
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    connection->sent += put;
+  }
+  PROFILE(profileStop(PHASE_OUTPUT, started));
+  connection->out.length = 0;
+  connection->sent = 0;
+  return 1;
+}
+
+/*
+ * check documents for clients of the Unix domain socket at socketName,
+ * with the dictionary loaded once, until SIGINT or SIGTERM.  Each
+ * connection is one document: the client writes it and shuts down its
+ * side, and gets back exactly what processInput would have printed for
+ * it, followed by the end of the connection.
+ *
+ * One thread serves every client from an epoll loop.  The sockets are
+ * non-blocking and edge triggered; a document is checked as it arrives,
+ * block by block, and the output waits in the connection's buffer until
+ * the client reads it.
+ */
+void serveRequests(char *socketName) {
+  struct sockaddr_un address;
+  struct epoll_event event;
+  struct epoll_event events[64];
+  struct sigaction action;
+  struct Connection *connection;
+  int listener;
+  int epoll;
+  int ready;
+  int i;
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(socketName) >= sizeof(address.sun_path)){
+    fprintf(stderr, "Socket name too long\n");
+    return;
+  }
+  strcpy(address.sun_path, socketName);
+
+  listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  unlink(socketName);
+  if (listener < 0 || bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+      listen(listener, SOMAXCONN) != 0){
+    perror(socketName);
+    if (listener >= 0){
+      close(listener);
+    }
+    return;
+  }
+
+  // a signal interrupts epoll_wait instead of killing the server
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stopServer;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  epoll = epoll_create1(EPOLL_CLOEXEC);
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+  epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+
+  while (!stopServing){
+    ready = epoll_wait(epoll, events, sizeof(events)/sizeof(events[0]), -1);
+    for (i = 0; i < ready; i++){
+      // the listening socket: take every waiting client
+      if (events[i].data.ptr == NULL){
+        int fd;
+        while ((fd = accept(listener, NULL, NULL)) >= 0){
+          fcntl(fd, F_SETFL, O_NONBLOCK);
+          fcntl(fd, F_SETFD, FD_CLOEXEC);
+          connection = calloc(1, sizeof(struct Connection));
+          connection->fd = fd;
+          connection->capacity = BLOCK_SIZE;
+          connection->text = malloc((connection->capacity + 1)*sizeof(char));
+          connection->next = connections;
+          if (connections != NULL){
+            connections->previous = connection;
+          }
+          connections = connection;
+          event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+          event.data.ptr = connection;
+          epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+        }
+        continue;
+      }
+
+      connection = events[i].data.ptr;
+      if (!readRequest(connection) || !writeResponse(connection) ||
+          (events[i].events & EPOLLERR)){
+        closeConnection(epoll, connection);
+      }
+      else if (connection->readAll && connection->out.length == 0){
+        closeConnection(epoll, connection);
+      }
+    }
+  }
+
+  // clients still being served when the server stops get cut off
+  while (connections != NULL){
+    closeConnection(epoll, connections);
+  }
+  close(epoll);
+  close(listener);
+  unlink(socketName);
+}
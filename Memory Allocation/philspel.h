@@ -11,4 +11,12 @@ extern void readDictionary(char *dictName);
 
 extern void processInput();
 
+extern void processInputBatched();
+
+extern void processInputBlocked();
+
+extern void processInputThreaded(int threads);
+
+extern void serveRequests(char *socketName);
+
 #endif
@@ -0,0 +1,108 @@
+#include "profile.h"
+#include <pthread.h>
+#include <string.h>
+
+__thread struct ProfileCounters profileCounters;
+
+int profiling;
+
+/*
+ * the counters of the threads that have merged theirs.
+ */
+static struct ProfileCounters totals;
+static pthread_mutex_t totalsLock = PTHREAD_MUTEX_INITIALIZER;
+
+void mergeProfileCounters(void) {
+  struct ProfileCounters *counters = &profileCounters;
+  int i = 0;
+  pthread_mutex_lock(&totalsLock);
+  for (i = 0; i < PROFILE_PHASES; ++i) {
+    totals.seconds[i] += counters->seconds[i];
+  }
+  totals.words += counters->words;
+  totals.unknownWords += counters->unknownWords;
+  totals.timedWords += counters->timedWords;
+  totals.timings += counters->timings;
+  totals.hits += counters->hits;
+  totals.misses += counters->misses;
+  totals.bytesIn += counters->bytesIn;
+  totals.bytesOut += counters->bytesOut;
+  pthread_mutex_unlock(&totalsLock);
+  memset(counters, 0, sizeof(*counters));
+}
+
+/*
+ * how much time reading the clock adds to a timing: the least of a few
+ * back to back readings, so an interrupt does not count.
+ */
+static double clockCost(void) {
+  double least = 1;
+  int i = 0;
+  for (i = 0; i < 1000; ++i) {
+    double started = profileClock();
+    double took = profileClock() - started;
+    if (took < least) {
+      least = took;
+    }
+  }
+  return least;
+}
+
+void printProfile(HashTable *table, int json, FILE *out) {
+  struct HashTableStats stats;
+  double lookup, scan, tokenize;
+  long lookups;
+  long resizes = -1;
+  double resizeSeconds = 0;
+
+  mergeProfileCounters();
+  if (table != NULL) {
+    getHashTableStats(table, &stats);
+    if (stats.counted) {
+      resizes = stats.counters.resizes;
+      resizeSeconds = stats.counters.resizeSeconds;
+    }
+  }
+  // only the sampled words' lookups were timed
+  lookup = totals.seconds[PHASE_LOOKUP] - totals.timings * clockCost();
+  lookup = totals.timedWords > 0 && lookup > 0
+               ? lookup * totals.words / totals.timedWords
+               : 0;
+  scan = totals.seconds[PHASE_SCAN];
+  if (scan == 0) {
+    scan = totals.seconds[PHASE_CHECK] - totals.seconds[PHASE_OUTPUT];
+  }
+  tokenize = scan > lookup ? scan - lookup : 0;
+  lookups = totals.hits + totals.misses;
+
+  if (json) {
+    fprintf(out, "{\"load_ms\": %.3f, ", totals.seconds[PHASE_LOAD] * 1e3);
+    if (resizes >= 0) {
+      fprintf(out, "\"resizes\": %ld, \"resize_ms\": %.3f, ", resizes,
+              resizeSeconds * 1e3);
+    }
+    fprintf(out,
+            "\"check_ms\": %.3f, \"tokenize_ms\": %.3f, "
+            "\"lookup_ms\": %.3f, \"output_ms\": %.3f, \"words\": %ld, "
+            "\"unknown_words\": %ld, \"lookups\": %ld, \"hits\": %ld, "
+            "\"misses\": %ld, \"bytes_in\": %ld, \"bytes_out\": %ld}\n",
+            totals.seconds[PHASE_CHECK] * 1e3, tokenize * 1e3, lookup * 1e3,
+            totals.seconds[PHASE_OUTPUT] * 1e3, totals.words,
+            totals.unknownWords, lookups, totals.hits, totals.misses,
+            totals.bytesIn, totals.bytesOut);
+    return;
+  }
+  fprintf(out, "profile: load %.3f ms", totals.seconds[PHASE_LOAD] * 1e3);
+  if (resizes >= 0) {
+    fprintf(out, " (%ld resizes %.3f ms)", resizes, resizeSeconds * 1e3);
+  }
+  fprintf(out,
+          ", check %.3f ms (tokenize %.3f, lookup %.3f, output %.3f), "
+          "%ld words (%ld unknown), %.2f lookups/word, %ld hits, "
+          "%ld misses, %ld bytes in, %ld bytes out\n",
+          totals.seconds[PHASE_CHECK] * 1e3, tokenize * 1e3, lookup * 1e3,
+          totals.seconds[PHASE_OUTPUT] * 1e3, totals.words,
+          totals.unknownWords,
+          totals.words ? (double)lookups / totals.words : 0.0,
+          totals.hits, totals.misses, totals.bytesIn, totals.bytesOut);
+}
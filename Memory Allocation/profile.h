@@ -0,0 +1,142 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "hashtable.h"
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Where a philspel run spends its time (--profile).  PROFILE(statement)
+ * only runs statement when philspel.c is built with -DPHILSPEL_PROFILE,
+ * otherwise none of the counting is compiled into the checking loops.
+ *
+ * The phases, timed with CLOCK_MONOTONIC:
+ *
+ *   PHASE_LOAD    reading the dictionary and building what checks it
+ *   PHASE_CHECK   the whole check of the input, reading it included
+ *   PHASE_SCAN    splitting text into words and checking them, the time
+ *                 in processBlock (the paths that read a character at a
+ *                 time have no separate scan, for them it is everything
+ *                 in PHASE_CHECK besides the lookups and the output)
+ *   PHASE_LOOKUP  checking words against the dictionary, hashing them
+ *                 included (part of PHASE_SCAN)
+ *   PHASE_OUTPUT  writing the output to stdout
+ *
+ * With --threads the scan and lookup times are added up over the
+ * threads, so they can be more than the check took.
+ */
+#ifdef PHILSPEL_PROFILE
+#define PROFILE(statement) statement
+#else
+#define PROFILE(statement)
+#endif
+
+/*
+ * Only one word in PROFILE_SAMPLE has its lookups timed, and the lookup
+ * time of the rest is estimated from those: reading the clock twice
+ * costs about as much as a lookup that hits the cache.  What reading the
+ * clock adds to each timing is measured and taken off again, and a
+ * timing of more than PROFILE_OUTLIER seconds a word is left out: the
+ * thread was most likely descheduled in the middle of it.
+ */
+#define PROFILE_SAMPLE 16
+#define PROFILE_OUTLIER 1e-4
+
+enum ProfilePhase {
+  PHASE_LOAD,
+  PHASE_CHECK,
+  PHASE_SCAN,
+  PHASE_LOOKUP,
+  PHASE_OUTPUT,
+  PROFILE_PHASES
+};
+
+struct ProfileCounters {
+  double seconds[PROFILE_PHASES];
+  long words;
+  long unknownWords;
+  long timedWords;
+  long timings;
+  long hits;
+  long misses;
+  long bytesIn;
+  long bytesOut;
+};
+
+/*
+ * The calling thread's counters.  A thread other than the main one adds
+ * them to the totals with mergeProfileCounters before it exits.
+ */
+extern __thread struct ProfileCounters profileCounters;
+
+/*
+ * Nonzero once the timing is wanted; the counters count regardless.
+ */
+extern int profiling;
+
+static inline double profileClock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * The start of a timed stretch, 0 if it is not timed.
+ */
+static inline double profileStart(void) {
+  return profiling ? profileClock() : 0;
+}
+
+/*
+ * profileStart for the lookups of the next word, which are only timed
+ * for one word in PROFILE_SAMPLE.
+ */
+static inline double profileStartWord(void) {
+  return profiling && profileCounters.words % PROFILE_SAMPLE == 0
+             ? profileClock()
+             : 0;
+}
+
+static inline void profileStop(enum ProfilePhase phase, double started) {
+  if (started != 0) {
+    profileCounters.seconds[phase] += profileClock() - started;
+  }
+}
+
+/*
+ * Ends the lookups of words words, started with profileStart or
+ * profileStartWord.
+ */
+static inline void profileStopWords(double started, int words) {
+  double took;
+  profileCounters.words += words;
+  if (started == 0) {
+    return;
+  }
+  took = profileClock() - started;
+  if (took <= PROFILE_OUTLIER * words) {
+    profileCounters.seconds[PHASE_LOOKUP] += took;
+    profileCounters.timedWords += words;
+    profileCounters.timings++;
+  }
+}
+
+static inline void profileLookup(int found) {
+  profileCounters.hits += found != 0;
+  profileCounters.misses += found == 0;
+}
+
+extern void mergeProfileCounters(void);
+
+/*
+ * Merges the calling thread's counters and prints the totals to out, one
+ * line, or one JSON object if json.  The resizes come from table's
+ * counters (see HASHTABLE_STATS); table may be NULL.
+ */
+extern void printProfile(HashTable *table, int json, FILE *out);
+
+#endif
@@ -0,0 +1,235 @@
+/*
+ * Latency benchmark for philspel --serve: checks the same document over
+ * and over, one request at a time, three ways
+ *
+ *   fork     a new ./philspel-O2 dictionary < document per request, the
+ *            way the command line is used now (loads the dictionary
+ *            every time)
+ *   client   a new ./spellclient socket < document per request, against
+ *            one ./philspel-O2 --serve
+ *   socket   a connection per request from this process, so the cost of
+ *            starting a process is left out as well
+ *
+ * and prints requests per second and the median and 99th percentile
+ * latency of each.  The dictionary is random words (half a million by
+ * default) so that loading it costs about what a real one does; the
+ * document is sampleInput.  Every output is compared against the first
+ * fork run.
+ *
+ * usage: ./serverbench [requests] [words]
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define DICTIONARY_FILE "serverbench.dict"
+#define DOCUMENT_FILE "sampleInput"
+#define OUTPUT_FILE "serverbench.out"
+#define SOCKET_FILE "serverbench.sock"
+
+static unsigned long long rngState = 88172645463325252ULL;
+
+static unsigned long long nextRandom(void) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return rngState;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static char *readFile(const char *filename, size_t *length) {
+  FILE *f = fopen(filename, "r");
+  char *data = NULL;
+  if (f == NULL) {
+    perror(filename);
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  *length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data = malloc(*length + 1);
+  *length = fread(data, 1, *length, f);
+  fclose(f);
+  return data;
+}
+
+/*
+ * runs program with standard input from DOCUMENT_FILE and standard
+ * output to OUTPUT_FILE, and waits for it.
+ */
+static void run(char *const *program) {
+  pid_t pid = fork();
+  int status;
+  if (pid == 0) {
+    dup2(open(DOCUMENT_FILE, O_RDONLY), STDIN_FILENO);
+    dup2(open(OUTPUT_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644), STDOUT_FILENO);
+    execv(program[0], program);
+    perror(program[0]);
+    _exit(1);
+  }
+  waitpid(pid, &status, 0);
+}
+
+static int connectServer(void) {
+  struct sockaddr_un address;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, SOCKET_FILE);
+  if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/*
+ * one request over a new connection, the reply goes to reply (which is
+ * big enough).  Returns the length of the reply.
+ */
+static size_t request(const char *document, size_t length, char *reply) {
+  int fd = connectServer();
+  size_t got = 0;
+  ssize_t n;
+  while (length > 0 && (n = write(fd, document, length)) > 0) {
+    document += n;
+    length -= n;
+  }
+  shutdown(fd, SHUT_WR);
+  while ((n = read(fd, reply + got, 1 << 20)) > 0) {
+    got += n;
+  }
+  close(fd);
+  return got;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static void report(const char *name, double *latencies, int requests,
+                   double total) {
+  qsort(latencies, requests, sizeof(double), compareDoubles);
+  printf("%-8s %12.0f %12.1f %12.1f\n", name, requests / (total / 1e9),
+         latencies[requests / 2] / 1e3, latencies[requests * 99 / 100] / 1e3);
+}
+
+/*
+ * checks OUTPUT_FILE against the expected output.
+ */
+static void checkOutput(const char *name, const char *expected,
+                        size_t expectedLength) {
+  size_t length;
+  char *output = readFile(OUTPUT_FILE, &length);
+  if (length != expectedLength || memcmp(output, expected, length) != 0) {
+    fprintf(stderr, "%s: wrong output\n", name);
+    exit(1);
+  }
+  free(output);
+}
+
+int main(int argc, char **argv) {
+  int requests = argc > 1 ? atoi(argv[1]) : 200;
+  int words = argc > 2 ? atoi(argv[2]) : 500000;
+  char *forkProgram[] = {"./philspel-O2", DICTIONARY_FILE, NULL};
+  char *clientProgram[] = {"./spellclient", SOCKET_FILE, NULL};
+  double *latencies = malloc(sizeof(double) * requests);
+  FILE *f = fopen(DICTIONARY_FILE, "w");
+  char *document = NULL;
+  char *expected = NULL;
+  char *reply = NULL;
+  size_t documentLength;
+  size_t expectedLength;
+  double start, total;
+  pid_t server;
+  int fd;
+  int i, j;
+
+  for (i = 0; i < words; ++i) {
+    int length = 3 + nextRandom() % 10;
+    for (j = 0; j < length; ++j) {
+      fputc('a' + nextRandom() % 26, f);
+    }
+    fputc('\n', f);
+  }
+  fclose(f);
+  /* so that the document is not all misspelled */
+  system("cat sampleDictionary >> " DICTIONARY_FILE);
+  document = readFile(DOCUMENT_FILE, &documentLength);
+  reply = malloc(4 * documentLength + (1 << 20));
+  run(forkProgram);
+  expected = readFile(OUTPUT_FILE, &expectedLength);
+
+  printf("%d requests of %zu bytes, %d word dictionary\n", requests,
+         documentLength, words);
+  printf("%-8s %12s %12s %12s\n", "", "requests/s", "p50 us", "p99 us");
+
+  total = now();
+  for (i = 0; i < requests; ++i) {
+    start = now();
+    run(forkProgram);
+    latencies[i] = now() - start;
+  }
+  report("fork", latencies, requests, now() - total);
+  checkOutput("fork", expected, expectedLength);
+
+  server = fork();
+  if (server == 0) {
+    execl("./philspel-O2", "philspel-O2", "--serve", SOCKET_FILE,
+          DICTIONARY_FILE, (char *)NULL);
+    perror("./philspel-O2");
+    _exit(1);
+  }
+  start = now();
+  while ((fd = connectServer()) < 0) {
+    usleep(1000);
+  }
+  close(fd);
+  printf("the server was ready after %.1f ms\n", (now() - start) / 1e6);
+
+  total = now();
+  for (i = 0; i < requests; ++i) {
+    start = now();
+    run(clientProgram);
+    latencies[i] = now() - start;
+  }
+  report("client", latencies, requests, now() - total);
+  checkOutput("client", expected, expectedLength);
+
+  total = now();
+  for (i = 0; i < requests; ++i) {
+    size_t length;
+    start = now();
+    length = request(document, documentLength, reply);
+    latencies[i] = now() - start;
+    if (length != expectedLength || memcmp(reply, expected, length) != 0) {
+      fprintf(stderr, "socket: wrong output\n");
+      return 1;
+    }
+  }
+  report("socket", latencies, requests, now() - total);
+
+  kill(server, SIGTERM);
+  waitpid(server, NULL, 0);
+  free(latencies);
+  free(document);
+  free(expected);
+  free(reply);
+  remove(DICTIONARY_FILE);
+  remove(OUTPUT_FILE);
+  return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <stddef.h>
+
+/*
+ * A slab pool hands out fixed size objects (the hashtable uses it for
+ * its HashBuckets) carved out of large blocks.  Allocating is a pointer
+ * bump, objects allocated one after another sit next to each other in
+ * memory, and freeSlabPool() releases every object at once.  Objects are
+ * never freed one at a time.
+ */
+struct Slab {
+  struct Slab *next;
+  size_t objects;
+};
+
+typedef struct SlabPool {
+  size_t objectSize;
+  size_t slabObjects;
+  struct Slab *slabs;
+  char *next;
+  char *end;
+} SlabPool;
+
+extern void initSlabPool(SlabPool *pool, size_t objectSize);
+
+/*
+ * count objects next to each other, in a slab of their own (so they can
+ * be handed out to several threads to fill in).  Allocation carries on in
+ * the current slab afterwards.
+ */
+extern void *slabAllocArray(SlabPool *pool, size_t count);
+
+/*
+ * Called by slabAlloc() when the current slab is used up.
+ */
+extern void *refillSlabPool(SlabPool *pool);
+
+extern void freeSlabPool(SlabPool *pool);
+
+/*
+ * How many bytes the pool's slabs take up, headers included.
+ */
+extern size_t slabPoolBytes(SlabPool *pool);
+
+static inline void *slabAlloc(SlabPool *pool) {
+  void *object = pool->next;
+  if (pool->next == pool->end) {
+    return refillSlabPool(pool);
+  }
+  pool->next += pool->objectSize;
+  return object;
+}
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * A thin client for philspel --serve: sends standard input to the server
+ * as one document and copies the checked text back to standard output,
+ * so
+ *
+ *   ./spellclient socket < document
+ *
+ * prints the same as ./philspel dictionary < document, without loading
+ * the dictionary.
+ *
+ * The whole document is sent before anything is read back.  That can not
+ * deadlock, since the server never stops reading: it keeps the output
+ * it could not send yet in memory.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CLIENT_BUFFER 65536
+
+/*
+ * write all length bytes of data to fd.  Returns 0 if that failed.
+ */
+static int writeAll(int fd, const char *data, size_t length) {
+  ssize_t put;
+  while (length > 0) {
+    put = write(fd, data, length);
+    if (put < 0) {
+      return 0;
+    }
+    data += put;
+    length -= put;
+  }
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  struct sockaddr_un address;
+  char *buffer = NULL;
+  ssize_t got;
+  int fd;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s socket < document\n", argv[0]);
+    return 1;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(argv[1]) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "%s: socket name too long\n", argv[1]);
+    return 1;
+  }
+  strcpy(address.sun_path, argv[1]);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 ||
+      connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  buffer = malloc(CLIENT_BUFFER);
+  while ((got = read(STDIN_FILENO, buffer, CLIENT_BUFFER)) > 0) {
+    if (!writeAll(fd, buffer, got)) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+  /* the end of the document */
+  shutdown(fd, SHUT_WR);
+
+  while ((got = read(fd, buffer, CLIENT_BUFFER)) > 0) {
+    if (!writeAll(STDOUT_FILENO, buffer, got)) {
+      return 1;
+    }
+  }
+  free(buffer);
+  close(fd);
+  return got < 0;
+}
@@ -0,0 +1,366 @@
+#include "suggest.h"
+#include "wordhash.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * The dictionary words indexed under one delete string.  Most strings
+ * belong to a single word, which is kept in first instead of an array.
+ */
+struct DeleteEntry {
+  int *words;
+  int count;
+  int capacity;
+  int first;
+  char key[];
+};
+
+/*
+ * The same hash and strcmp equality philspel uses for its words.
+ */
+static unsigned int deleteHash(void *s) {
+  return wordHash((char *)s, strlen((char *)s));
+}
+
+static int deleteEquals(void *s1, void *s2) {
+  return strcmp((char *)s1, (char *)s2) == 0;
+}
+
+static char foldCase(char c) {
+  return tolower((unsigned char)c);
+}
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Calls visit on key (of length letters) and every string made by
+ * deleting up to distance of its letters at positions from onwards.
+ * Deleting in increasing position order makes each set of positions
+ * once, although repeated letters can still give the same string twice.
+ */
+static void forEachDelete(char *key, int length, int from, int distance,
+                          void (*visit)(char *, void *), void *context) {
+  char shorter[SUGGEST_PREFIX + 1];
+  int i = 0;
+  visit(key, context);
+  if (distance == 0) {
+    return;
+  }
+  for (i = from; i < length; ++i) {
+    memcpy(shorter, key, i);
+    memcpy(shorter + i, key + i + 1, length - i);
+    forEachDelete(shorter, length - 1, i, distance - 1, visit, context);
+  }
+}
+
+struct Posting {
+  SuggestionIndex *index;
+  int word;
+};
+
+static void addPosting(char *key, void *context) {
+  struct Posting *posting = context;
+  SuggestionIndex *index = posting->index;
+  struct DeleteEntry *entry = findData(index->deletes, key);
+  if (entry == NULL) {
+    size_t length = strlen(key);
+    entry = malloc(sizeof(struct DeleteEntry) + length + 1);
+    memcpy(entry->key, key, length + 1);
+    entry->words = &entry->first;
+    entry->count = 0;
+    entry->capacity = 1;
+    insertData(index->deletes, entry->key, entry);
+    // remember it so it can be freed, the hashtable does not own it
+    if (index->entryCount == index->entryCapacity) {
+      index->entryCapacity = 2 * index->entryCapacity + 1024;
+      index->entries = realloc(index->entries, index->entryCapacity *
+                               sizeof(struct DeleteEntry *));
+    }
+    index->entries[index->entryCount++] = entry;
+    index->bytes += sizeof(struct DeleteEntry) + length + 1;
+  }
+  // the same word again, through another set of deleted positions
+  if (entry->count > 0 && entry->words[entry->count - 1] == posting->word) {
+    return;
+  }
+  if (entry->count == entry->capacity) {
+    int *words = malloc(2 * entry->capacity * sizeof(int));
+    memcpy(words, entry->words, entry->count * sizeof(int));
+    if (entry->words != &entry->first) {
+      free(entry->words);
+      index->bytes -= entry->capacity * sizeof(int);
+    }
+    entry->words = words;
+    entry->capacity *= 2;
+    index->bytes += entry->capacity * sizeof(int);
+  }
+  entry->words[entry->count++] = posting->word;
+  index->postings++;
+}
+
+SuggestionIndex *createSuggestionIndex(char **words, int count,
+                                       int maxDistance) {
+  SuggestionIndex *index = calloc(1, sizeof(SuggestionIndex));
+  HashTable *seen = createHashTable(count + 1, deleteHash, deleteEquals);
+  char **lowered = malloc((count + 1) * sizeof(char *));
+  struct HashTableStats stats;
+  double start = seconds();
+  int i = 0;
+
+  index->maxDistance = maxDistance;
+  index->deletes = createHashTable(count + 1, deleteHash, deleteEquals);
+  index->words = malloc((count + 1) * sizeof(char *));
+  index->bytes = (count + 1) * sizeof(char *);
+  for (i = 0; i < count; ++i) {
+    size_t length = strlen(words[i]);
+    char *lower = malloc(length + 1);
+    char key[SUGGEST_PREFIX + 1];
+    struct Posting posting;
+    size_t j = 0;
+    for (j = 0; j <= length; ++j) {
+      lower[j] = tolower((unsigned char)words[i][j]);
+    }
+    if (findData(seen, lower) != NULL) {
+      free(lower);
+      continue;
+    }
+    insertData(seen, lower, lower);
+    lowered[index->count] = lower;
+    index->words[index->count] = malloc(length + 1);
+    memcpy(index->words[index->count], words[i], length + 1);
+    index->bytes += length + 1;
+
+    if (length > SUGGEST_PREFIX) {
+      length = SUGGEST_PREFIX;
+    }
+    memcpy(key, lower, length);
+    key[length] = '\0';
+    posting.index = index;
+    posting.word = index->count++;
+    forEachDelete(key, length, 0, maxDistance, addPosting, &posting);
+  }
+  freeTable(seen);
+  for (i = 0; i < index->count; ++i) {
+    free(lowered[i]);
+  }
+  free(lowered);
+
+  getHashTableStats(index->deletes, &stats);
+  index->bytes += stats.arrayBytes + stats.nodeBytes;
+  index->bytes += index->entryCapacity * sizeof(struct DeleteEntry *);
+  index->buildSeconds = seconds() - start;
+  return index;
+}
+
+/*
+ * The optimal string alignment distance between a and b (the edit
+ * distance counting a swap of neighbouring letters as one edit), or
+ * max + 1 once it is known to be over max.  a is lowercase, b is
+ * lowercased as it is compared.
+ */
+static int editDistance(const char *a, int n, const char *b, int m, int max) {
+  int stackRows[3 * 64];
+  int *rows = m < 64 ? stackRows : malloc(3 * (m + 1) * sizeof(int));
+  int *before = rows;
+  int *previous = rows + m + 1;
+  int *current = rows + 2 * (m + 1);
+  int distance = 0;
+  int i = 0, j = 0;
+
+  if (n - m > max || m - n > max) {
+    distance = max + 1;
+    goto done;
+  }
+  for (j = 0; j <= m; ++j) {
+    previous[j] = j;
+  }
+  for (i = 1; i <= n; ++i) {
+    int rowMin = i;
+    int *swap = NULL;
+    current[0] = i;
+    for (j = 1; j <= m; ++j) {
+      int value = previous[j - 1] + (a[i - 1] != foldCase(b[j - 1]));
+      if (previous[j] + 1 < value) {
+        value = previous[j] + 1;
+      }
+      if (current[j - 1] + 1 < value) {
+        value = current[j - 1] + 1;
+      }
+      if (i > 1 && j > 1 && a[i - 1] == foldCase(b[j - 2]) &&
+          a[i - 2] == foldCase(b[j - 1]) &&
+          before[j - 2] + 1 < value) {
+        value = before[j - 2] + 1;
+      }
+      current[j] = value;
+      if (value < rowMin) {
+        rowMin = value;
+      }
+    }
+    if (rowMin > max) {
+      distance = max + 1;
+      goto done;
+    }
+    swap = before;
+    before = previous;
+    previous = current;
+    current = swap;
+  }
+  distance = previous[m] > max ? max + 1 : previous[m];
+done:
+  if (rows != stackRows) {
+    free(rows);
+  }
+  return distance;
+}
+
+/*
+ * The candidates of one lookup: the words of every matching delete
+ * string, duplicates and all.
+ */
+struct Candidates {
+  SuggestionIndex *index;
+  int *words;
+  int count;
+  int capacity;
+};
+
+static void addCandidates(char *key, void *context) {
+  struct Candidates *candidates = context;
+  struct DeleteEntry *entry = findData(candidates->index->deletes, key);
+  if (entry == NULL) {
+    return;
+  }
+  if (candidates->count + entry->count > candidates->capacity) {
+    candidates->capacity = 2 * (candidates->count + entry->count);
+    candidates->words = realloc(candidates->words,
+                                candidates->capacity * sizeof(int));
+  }
+  memcpy(candidates->words + candidates->count, entry->words,
+         entry->count * sizeof(int));
+  candidates->count += entry->count;
+}
+
+static int compareInts(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+struct Suggestion {
+  const char *word;
+  int distance;
+  int lengthDifference;
+};
+
+static int compareSuggestions(const void *a, const void *b) {
+  const struct Suggestion *x = a;
+  const struct Suggestion *y = b;
+  if (x->distance != y->distance) {
+    return x->distance - y->distance;
+  }
+  if (x->lengthDifference != y->lengthDifference) {
+    return x->lengthDifference - y->lengthDifference;
+  }
+  return strcmp(x->word, y->word);
+}
+
+int findSuggestions(SuggestionIndex *index, const char *word, size_t length,
+                    const char **suggestions, int max) {
+  char shortWord[64];
+  char *lower = length < sizeof(shortWord) ? shortWord : malloc(length + 1);
+  char key[SUGGEST_PREFIX + 1];
+  struct Candidates candidates;
+  struct Suggestion *found = NULL;
+  int foundCount = 0;
+  int i = 0;
+  size_t j = 0;
+
+  for (j = 0; j < length; ++j) {
+    lower[j] = tolower((unsigned char)word[j]);
+  }
+  lower[length] = '\0';
+  j = length < SUGGEST_PREFIX ? length : SUGGEST_PREFIX;
+  memcpy(key, lower, j);
+  key[j] = '\0';
+
+  candidates.index = index;
+  candidates.words = NULL;
+  candidates.count = 0;
+  candidates.capacity = 0;
+  forEachDelete(key, j, 0, index->maxDistance, addCandidates, &candidates);
+  // no candidates leaves words NULL, which qsort must not be given
+  if (candidates.count > 1) {
+    qsort(candidates.words, candidates.count, sizeof(int), compareInts);
+  }
+
+  // check each distinct candidate against the whole word
+  found = malloc((candidates.count + 1) * sizeof(struct Suggestion));
+  for (i = 0; i < candidates.count; ++i) {
+    const char *candidate = index->words[candidates.words[i]];
+    int candidateLength = strlen(candidate);
+    int distance = 0;
+    if (i > 0 && candidates.words[i] == candidates.words[i - 1]) {
+      continue;
+    }
+    distance = editDistance(lower, length, candidate, candidateLength,
+                            index->maxDistance);
+    if (distance > index->maxDistance) {
+      continue;
+    }
+    found[foundCount].word = candidate;
+    found[foundCount].distance = distance;
+    found[foundCount].lengthDifference =
+        abs(candidateLength - (int)length);
+    foundCount++;
+  }
+  if (foundCount > 1) {
+    qsort(found, foundCount, sizeof(struct Suggestion), compareSuggestions);
+  }
+  if (foundCount > max) {
+    foundCount = max;
+  }
+  for (i = 0; i < foundCount; ++i) {
+    suggestions[i] = found[i].word;
+  }
+
+  free(found);
+  free(candidates.words);
+  if (lower != shortWord) {
+    free(lower);
+  }
+  return foundCount;
+}
+
+void printSuggestionIndexStats(SuggestionIndex *index, FILE *out) {
+  fprintf(out, "suggestion index: %d words, %d delete strings, %ld postings, "
+          "distance %d\n", index->count, index->deletes->used,
+          index->postings, index->maxDistance);
+  fprintf(out, "memory: %zu bytes, %.1f bytes per word, built in %.3f seconds\n",
+          index->bytes,
+          index->count ? (double)index->bytes / index->count : 0.0,
+          index->buildSeconds);
+}
+
+void freeSuggestionIndex(SuggestionIndex *index) {
+  int i = 0;
+  for (i = 0; i < index->entryCount; ++i) {
+    struct DeleteEntry *entry = index->entries[i];
+    if (entry->words != &entry->first) {
+      free(entry->words);
+    }
+    free(entry);
+  }
+  free(index->entries);
+  for (i = 0; i < index->count; ++i) {
+    free(index->words[i]);
+  }
+  freeTable(index->deletes);
+  free(index->words);
+  free(index);
+}
@@ -0,0 +1,67 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _SUGGEST_H_
+#define _SUGGEST_H_
+
+#include <stdio.h>
+#include "hashtable.h"
+
+/*
+ * Spelling suggestions from a symmetric delete index (as in SymSpell).
+ * Every dictionary word is indexed under itself and every string made by
+ * deleting up to maxDistance of its letters.  The candidates for a word
+ * are then found by looking up the word and its own deletes, since two
+ * words within edit distance d always share a string made by deleting at
+ * most d letters from each.  The candidates are checked with the real
+ * (optimal string alignment) distance.
+ *
+ * Only the first SUGGEST_PREFIX letters of a word are used for deletes,
+ * which bounds the index at O(SUGGEST_PREFIX^maxDistance) strings per
+ * word however long the words are, at the price of missing candidates
+ * whose prefixes alone are already too far apart.
+ *
+ * Words are indexed and looked up lowercase, but suggested as the
+ * dictionary spells them.  The index copies what it needs, the words do
+ * not have to outlive it.
+ */
+#define SUGGEST_PREFIX 7
+#define SUGGEST_MAX_DISTANCE 2
+
+struct DeleteEntry;
+
+typedef struct SuggestionIndex {
+  HashTable *deletes;
+  struct DeleteEntry **entries;
+  int entryCount;
+  int entryCapacity;
+  char **words;
+  int count;
+  int maxDistance;
+  long postings;
+  size_t bytes;
+  double buildSeconds;
+} SuggestionIndex;
+
+/*
+ * Builds the index of count words for edit distances up to maxDistance
+ * (1 or 2).  Words that only differ in case are indexed once.
+ */
+extern SuggestionIndex *createSuggestionIndex(char **words, int count,
+                                              int maxDistance);
+
+/*
+ * Fills suggestions with up to max dictionary words (owned by the index) closest to the word of length letters at word, nearest
+ * first, and returns how many there are.  Ties are broken by the
+ * difference in length and then alphabetically.  Does not modify the
+ * index, so several threads can look up at once.
+ */
+extern int findSuggestions(SuggestionIndex *index, const char *word,
+                           size_t length, const char **suggestions, int max);
+
+extern void printSuggestionIndexStats(SuggestionIndex *index, FILE *out);
+
+extern void freeSuggestionIndex(SuggestionIndex *index);
+
+#endif
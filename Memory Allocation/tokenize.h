@@ -0,0 +1,84 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _TOKENIZE_H_
+#define _TOKENIZE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Word splitting for philspel, TOKEN_STEP bytes at a time.  A word is a
+ * run of letters, isalpha() in the C locale: A-Z and a-z.  Every other
+ * byte (digits, punctuation, whitespace, bytes over 127) separates words,
+ * so "this!is3normal" is the three words this, is and normal.
+ *
+ * A byte c is a letter exactly when (c | 0x20) - 'a' is below 26 as an
+ * unsigned byte, which is a handful of vector instructions for a whole
+ * step of bytes at once.
+ */
+#ifdef __AVX2__
+#define TOKEN_STEP 32
+#elif defined(__SSE2__)
+#define TOKEN_STEP 16
+#else
+#define TOKEN_STEP 8
+#endif
+
+/*
+ * Bit i is set if text[i] is a letter, for the first count bytes (and
+ * no more are read).
+ */
+static inline uint32_t letterMaskScalar(const char *text, size_t count) {
+  uint32_t mask = 0;
+  size_t i = 0;
+  for (i = 0; i < count; ++i) {
+    unsigned char folded = (unsigned char)(text[i] | 0x20) - 'a';
+    mask |= (uint32_t)(folded < 26) << i;
+  }
+  return mask;
+}
+
+/*
+ * Bit i is set if text[i] is a letter, for all TOKEN_STEP bytes.
+ */
+static inline uint32_t letterMask(const char *text) {
+#ifdef __AVX2__
+  __m256i bytes = _mm256_loadu_si256((const __m256i *)text);
+  __m256i folded = _mm256_sub_epi8(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)),
+                                   _mm256_set1_epi8('a'));
+  __m256i letters = _mm256_cmpeq_epi8(
+      _mm256_min_epu8(folded, _mm256_set1_epi8(25)), folded);
+  return (uint32_t)_mm256_movemask_epi8(letters);
+#elif defined(__SSE2__)
+  __m128i bytes = _mm_loadu_si128((const __m128i *)text);
+  __m128i folded = _mm_sub_epi8(_mm_or_si128(bytes, _mm_set1_epi8(0x20)),
+                                _mm_set1_epi8('a'));
+  __m128i letters =
+      _mm_cmpeq_epi8(_mm_min_epu8(folded, _mm_set1_epi8(25)), folded);
+  return (uint32_t)_mm_movemask_epi8(letters);
+#else
+  return letterMaskScalar(text, TOKEN_STEP);
+#endif
+}
+
+/*
+ * Given the letter mask of a step and whether the byte before the step
+ * was a letter, the bits where a word starts (a letter after a
+ * non-letter) and where one ends (a non-letter after a letter).
+ */
+static inline uint32_t wordStarts(uint32_t letters, uint32_t inWord) {
+  return letters & ~((letters << 1) | inWord);
+}
+
+static inline uint32_t wordEnds(uint32_t letters, uint32_t inWord) {
+  return ~letters & ((letters << 1) | inWord);
+}
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _WORDHASH_H_
+#define _WORDHASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * philspel's string hash, eight bytes per step instead of djb2's one.
+ * Each step folds a 64 bit chunk of the string into the state with the
+ * wyhash multiply-and-fold (the 128 bit product of the two, its halves
+ * xored together), and the length goes into the last step.  The last
+ * chunk holds the remaining 1 to 7 bytes, zero padded, and is read
+ * without touching any byte past the end.
+ *
+ * Chunks are read little endian, byte i of a chunk being bits 8i to
+ * 8i + 7, so a caller can change single bytes of a chunk (lowercase it,
+ * say) and get the hash of the changed string without another pass; see
+ * hashWordSpellings in philspel.c.
+ */
+#define WORDHASH_SEED 0xa0761d6478bd642fULL
+#define WORDHASH_CHUNK 0xe7037ed1a0b428dbULL
+#define WORDHASH_STATE 0x8ebc6af09c88c6e3ULL
+#define WORDHASH_FINISH 0x589965cc75374cc3ULL
+
+static inline uint64_t wordHashMix(uint64_t a, uint64_t b) {
+  __uint128_t product = (__uint128_t)a * b;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static inline uint64_t wordHashLoad(const char *p) {
+  uint64_t chunk;
+  memcpy(&chunk, p, sizeof(chunk));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  chunk = __builtin_bswap64(chunk);
+#endif
+  return chunk;
+}
+
+static inline uint32_t wordHashLoad32(const char *p) {
+  uint32_t chunk;
+  memcpy(&chunk, p, sizeof(chunk));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  chunk = __builtin_bswap32(chunk);
+#endif
+  return chunk;
+}
+
+static inline void wordHashStore(char *p, uint64_t chunk) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  chunk = __builtin_bswap64(chunk);
+#endif
+  memcpy(p, &chunk, sizeof(chunk));
+}
+
+/*
+ * The last chunk of a string of length bytes, whose last count (1 to 7)
+ * bytes start at p.  Strings of 8 bytes or more reread the end of the
+ * previous chunk and shift it away; shorter ones combine overlapping
+ * loads that stay within the string.
+ */
+static inline uint64_t wordHashTail(const char *p, size_t count,
+                                    size_t length) {
+  if (length >= 8) {
+    return wordHashLoad(p + count - 8) >> (64 - 8 * count);
+  }
+  if (count >= 4) {
+    return wordHashLoad32(p) |
+           (uint64_t)wordHashLoad32(p + count - 4) << (8 * (count - 4));
+  }
+  return (uint64_t)(unsigned char)p[0] |
+         (uint64_t)(unsigned char)p[count / 2] << (8 * (count / 2)) |
+         (uint64_t)(unsigned char)p[count - 1] << (8 * (count - 1));
+}
+
+static inline uint64_t wordHashStep(uint64_t state, uint64_t chunk) {
+  return wordHashMix(chunk ^ WORDHASH_CHUNK, state ^ WORDHASH_STATE);
+}
+
+static inline unsigned int wordHashFinish(uint64_t state, size_t length) {
+  state = wordHashMix(state ^ length, WORDHASH_FINISH);
+  return (unsigned int)(state ^ (state >> 32));
+}
+
+/*
+ * The hash of the length bytes at word.
+ */
+static inline unsigned int wordHash(const char *word, size_t length) {
+  uint64_t state = WORDHASH_SEED;
+  size_t at = 0;
+  for (at = 0; at + 8 <= length; at += 8) {
+    state = wordHashStep(state, wordHashLoad(word + at));
+  }
+  if (at < length) {
+    state = wordHashStep(state, wordHashTail(word + at, length - at, length));
+  }
+  return wordHashFinish(state, length);
+}
+
+#endif
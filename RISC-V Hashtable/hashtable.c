@@ -15,6 +15,7 @@ HashTable *createHashTable(int size, unsigned int (*hashFunction)(void *),
   }
   newTable->hashFunction = hashFunction;
   newTable->equalFunction = equalFunction;
+  initSlabPool(&newTable->buckets, sizeof(struct HashBucket));
   return newTable;
 }
 
@@ -22,7 +23,7 @@ HashTable *createHashTable(int size, unsigned int (*hashFunction)(void *),
 void insertData(HashTable *table, void *key, void *data) {
   unsigned int location  = 0;
   struct HashBucket *newBucket =
-      (struct HashBucket *)malloc(sizeof(struct HashBucket));
+      (struct HashBucket *)slabAlloc(&table->buckets);
 
   /*
    * This is where we would check occupancy and resize, but we aren't
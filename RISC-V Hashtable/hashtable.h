@@ -6,6 +6,8 @@
 #ifndef _HASHTABLE_H_
 #define _HASHTABLE_H_
 
+#include "slab.h"
+
 #ifndef NULL
 #define NULL ((void *)0)
 #endif
@@ -28,6 +30,11 @@ typedef struct HashTable {
   struct HashBucket **data;
   int size;
   int used;
+  /*
+   * Only the C implementation uses this; the assembly version allocates
+   * its buckets itself and never touches it.
+   */
+  SlabPool buckets;
 } HashTable;
 
 extern HashTable *createHashTable(int size,
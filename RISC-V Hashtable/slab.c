@@ -0,0 +1,64 @@
+
+#include "slab.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+/*
+ * Slabs start small so tiny tables stay tiny, then double until they
+ * reach MAX_SLAB_OBJECTS, so a table of a few million entries only needs
+ * a few dozen slabs.
+ */
+#define FIRST_SLAB_OBJECTS 64
+#define MAX_SLAB_OBJECTS 65536
+
+void initSlabPool(SlabPool *pool, size_t objectSize) {
+  /*
+   * Round up so every object stays pointer aligned.
+   */
+  pool->objectSize = (objectSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  pool->slabObjects = FIRST_SLAB_OBJECTS;
+  pool->slabs = NULL;
+  pool->next = NULL;
+  pool->end = NULL;
+}
+
+void *refillSlabPool(SlabPool *pool) {
+  struct Slab *slab =
+      malloc(sizeof(struct Slab) + pool->objectSize * pool->slabObjects);
+  if (slab == NULL) {
+    fprintf(stderr, "Out of memory allocating a slab\n");
+    exit(1);
+  }
+  slab->objects = pool->slabObjects;
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->next = (char *)(slab + 1);
+  pool->end = pool->next + pool->objectSize * pool->slabObjects;
+  if (pool->slabObjects < MAX_SLAB_OBJECTS) {
+    pool->slabObjects *= 2;
+  }
+  return slabAlloc(pool);
+}
+
+void freeSlabPool(SlabPool *pool) {
+  struct Slab *at = pool->slabs;
+  struct Slab *old = NULL;
+  while (at != NULL) {
+    old = at;
+    at = at->next;
+    free(old);
+  }
+  pool->slabs = NULL;
+  pool->next = NULL;
+  pool->end = NULL;
+}
+
+size_t slabPoolBytes(SlabPool *pool) {
+  struct Slab *at = pool->slabs;
+  size_t bytes = 0;
+  while (at != NULL) {
+    bytes += sizeof(struct Slab) + pool->objectSize * at->objects;
+    at = at->next;
+  }
+  return bytes;
+}
@@ -3,47 +3,191 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+/*
+ * The murmur3 64 bit finalizer, so that masking off the low bits of the
+ * hash (HASHTABLE_POW2) still depends on all of its bits.
+ */
+static uint64_t mixHash(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+static uint32_t bucketIndex(HashTable *table, uint64_t hash) {
+  if (table->flags & HASHTABLE_POW2) {
+    return mixHash(hash) & (table->size - 1);
+  }
+  return hash % table->size;
+}
+
+/*
+ * What a HashNode keeps of a hash: its four 16 bit quarters xored
+ * together, so it does not only repeat the bits that picked the bucket.
+ */
+static uint16_t hashFragment(uint64_t hash) {
+  hash ^= hash >> 32;
+  return (uint16_t)(hash ^ (hash >> 16));
+}
+
 HashTable *createHashTable(int32_t size, uint64_t (*hashFunction)(void *),
                            int32_t (*equalFunction)(void *, void *)) {
+  return createHashTableWithFlags(size, hashFunction, equalFunction, 0);
+}
+
+HashTable *createHashTableWithFlags(int32_t size,
+                                    uint64_t (*hashFunction)(void *),
+                                    int32_t (*equalFunction)(void *, void *),
+                                    uint32_t flags) {
   int i = 0;
   HashTable *newTable = malloc(sizeof(HashTable));
+  if (flags & HASHTABLE_POW2) {
+    int pow2 = 1;
+    while (pow2 < size) {
+      pow2 *= 2;
+    }
+    size = pow2;
+  }
   newTable->size = size;
   newTable->used = 0;
+  newTable->flags = flags;
   newTable->data = malloc(sizeof(struct HashBucket *) * size);
   for (i = 0; i < size; ++i) {
     newTable->data[i] = NULL;
   }
   newTable->hashFunction = hashFunction;
   newTable->equalFunction = equalFunction;
+  initSlabPool(&newTable->buckets, flags & HASHTABLE_UNROLLED
+                                       ? sizeof(struct HashNode)
+                                       : sizeof(struct HashBucket));
   return newTable;
 }
 
+/*
+ * Adds the pair to the first node of its chain, or a new first node when
+ * that one is full.
+ */
+static void insertNode(HashTable *table, void *key, void *data,
+                       uint64_t hash) {
+  struct HashNode **slot =
+      (struct HashNode **)&table->data[bucketIndex(table, hash)];
+  struct HashNode *node = *slot;
+  if (node == NULL || node->count == HASHTABLE_NODE_KEYS) {
+    node = (struct HashNode *)slabAlloc(&table->buckets);
+    node->next = *slot;
+    node->count = 0;
+    *slot = node;
+  }
+  node->fragments[node->count] = hashFragment(hash);
+  node->keys[node->count] = key;
+  node->data[node->count] = data;
+  node->count += 1;
+}
+
+static void *findNode(HashTable *table, struct HashNode *lookAt, void *key,
+                      uint64_t hash) {
+  uint16_t fragment = hashFragment(hash);
+  uint32_t i = 0;
+  while (lookAt != NULL) {
+    for (i = 0; i < lookAt->count; ++i) {
+      if (lookAt->fragments[i] == fragment &&
+          (table->equalFunction)(key, lookAt->keys[i]) != 0) {
+        return lookAt->data[i];
+      }
+    }
+    lookAt = lookAt->next;
+  }
+  return NULL;
+}
+
 
 void insertData(HashTable *table, void *key, void *data) {
   unsigned int location  = 0;
-  struct HashBucket *newBucket =
-      (struct HashBucket *)malloc(sizeof(struct HashBucket));
+  uint64_t hash = 0;
+  struct HashBucket *newBucket = NULL;
 
   /*
    * This is where we would check occupancy and resize, but we aren't
    * doing that here...
    */ 
-  location  = ((table->hashFunction)(key)) % table->size;
+  hash = (table->hashFunction)(key);
+  if (table->flags & HASHTABLE_UNROLLED) {
+    insertNode(table, key, data, hash);
+    table->used += 1;
+    return;
+  }
+  newBucket = (struct HashBucket *)slabAlloc(&table->buckets);
+  location  = bucketIndex(table, hash);
   newBucket->next = table->data[location];
   newBucket->data = data;
   newBucket->key = key;
+  newBucket->hash = hash;
   table->data[location] = newBucket;
   table->used += 1;
 }
 
 void *findData(HashTable *table, void *key) {
-  unsigned int location = ((table->hashFunction)(key)) % table->size;
-  struct HashBucket *lookAt = table->data[location];
+  uint64_t hash = (table->hashFunction)(key);
+  struct HashBucket *lookAt = table->data[bucketIndex(table, hash)];
+  if (table->flags & HASHTABLE_UNROLLED) {
+    return findNode(table, (struct HashNode *)lookAt, key, hash);
+  }
   while (lookAt != NULL) {
-    if ((table->equalFunction)(key, lookAt->key) != 0) {
+    if (lookAt->hash == hash &&
+        (table->equalFunction)(key, lookAt->key) != 0) {
       return lookAt->data;
     }
     lookAt = lookAt->next;
   }
   return NULL;
 }
+
+/*
+ * BATCH_WIDTH keys at a time: hash them all and prefetch their bucket
+ * slots, then load and prefetch the chain heads, then walk the chains,
+ * so the cache misses of the different keys overlap.
+ */
+#define BATCH_WIDTH 8
+
+void findDataBatch(HashTable *table, void **keys, void **out, uint64_t n) {
+  uint64_t hashes[BATCH_WIDTH];
+  struct HashBucket **slots[BATCH_WIDTH];
+  struct HashBucket *heads[BATCH_WIDTH];
+  struct HashBucket *lookAt = NULL;
+  uint64_t done = 0;
+  uint64_t width = 0;
+  uint64_t i = 0;
+  for (done = 0; done < n; done += width) {
+    width = n - done < BATCH_WIDTH ? n - done : BATCH_WIDTH;
+    for (i = 0; i < width; ++i) {
+      hashes[i] = (table->hashFunction)(keys[done + i]);
+      slots[i] = &table->data[bucketIndex(table, hashes[i])];
+      __builtin_prefetch(slots[i]);
+    }
+    for (i = 0; i < width; ++i) {
+      heads[i] = *slots[i];
+      if (heads[i] != NULL) {
+        __builtin_prefetch(heads[i]);
+      }
+    }
+    for (i = 0; i < width; ++i) {
+      if (table->flags & HASHTABLE_UNROLLED) {
+        out[done + i] = findNode(table, (struct HashNode *)heads[i],
+                                 keys[done + i], hashes[i]);
+        continue;
+      }
+      lookAt = heads[i];
+      out[done + i] = NULL;
+      while (lookAt != NULL) {
+        if (lookAt->hash == hashes[i] &&
+            (table->equalFunction)(keys[done + i], lookAt->key) != 0) {
+          out[done + i] = lookAt->data;
+          break;
+        }
+        lookAt = lookAt->next;
+      }
+    }
+  }
+}
@@ -6,6 +6,7 @@
 #ifndef _HASHTABLE_H_
 #define _HASHTABLE_H_
 #include <stdint.h>
+#include "slab.h"
 
 
 
@@ -19,24 +20,66 @@
  * compute the hash and an int (*) (void *, void *) for equal true/false
  */
 
+/*
+ * hash caches the key's hashFunction value so chain walks can skip
+ * equalFunction on buckets whose hash differs.
+ */
 struct HashBucket {
   void *key;
   void *data;
   struct HashBucket *next;
+  uint64_t hash;
+};
+
+/*
+ * The chain node of a HASHTABLE_UNROLLED table: one 64 byte cache line
+ * holding up to HASHTABLE_NODE_KEYS pairs and a 16 bit fragment of each
+ * key's hash, so one hop down the chain checks several keys.  Only the
+ * first node of a chain is ever partly full.
+ */
+#define HASHTABLE_NODE_KEYS 3
+
+struct HashNode {
+  struct HashNode *next;
+  uint16_t fragments[HASHTABLE_NODE_KEYS];
+  uint16_t count;
+  void *keys[HASHTABLE_NODE_KEYS];
+  void *data[HASHTABLE_NODE_KEYS];
 };
 
+/*
+ * Flags for createHashTableWithFlags().  HASHTABLE_POW2 rounds the size
+ * up to a power of two and picks the bucket by masking a mixed hash
+ * instead of dividing by the size.  HASHTABLE_UNROLLED chains HashNodes
+ * instead of HashBuckets; the bucket array then holds HashNode pointers.
+ */
+#define HASHTABLE_POW2 0x4
+#define HASHTABLE_UNROLLED 0x8
+
 typedef struct HashTable {
   uint64_t (*hashFunction)(void *);
   int32_t (*equalFunction)(void *, void *);
   struct HashBucket **data;
   uint32_t size;
   uint32_t used;
+  uint32_t flags;
+  /*
+   * Only the C implementation uses this; the assembly version allocates
+   * its buckets itself and never touches it.
+   */
+  SlabPool buckets;
 } HashTable;
 
 extern HashTable *createHashTable(int size,
                                   uint64_t (*hashFunction)(void *),
                                   int32_t (*equalFunction)(void *, void *));
 
+extern HashTable *createHashTableWithFlags(int size,
+                                           uint64_t (*hashFunction)(void *),
+                                           int32_t (*equalFunction)(void *,
+                                                                    void *),
+                                           uint32_t flags);
+
 /*
  * If you insert with a key that already exists this is undefined behavior:
  * Future fetches may sometimes get the new data or sometimes the old data,
@@ -46,4 +89,11 @@ extern void insertData(HashTable *table, void *key, void *data);
 
 extern void *findData(HashTable *table, void *key);
 
+/*
+ * Looks up n keys at once, out[i] = findData(table, keys[i]), overlapping
+ * the memory accesses of the different lookups.
+ */
+extern void findDataBatch(HashTable *table, void **keys, void **out,
+                          uint64_t n);
+
 #endif
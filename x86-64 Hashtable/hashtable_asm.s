@@ -22,23 +22,52 @@ todo:	.string "Need to implement!"
 
 .text
 	.globl createHashTable
+	.globl createHashTableWithFlags
 	.globl insertData
 	.globl findData
+	.globl findDataBatch
 
+/*
+ * struct HashBucket: key at 0, data at 8, next at 16, hash at 24 (32 bytes)
+ * struct HashNode (HASHTABLE_UNROLLED): next at 0, 16 bit hash fragments
+ * at 8, 10 and 12, count at 14, keys at 16, 24 and 32, data at 40, 48
+ * and 56 (64 bytes, one cache line)
+ * HashTable: hash function at 0, equal function at 8, data at 16,
+ * size at 24, used at 28, flags at 32 (40 bytes, the C only slab pool
+ * that follows is not allocated here)
+ */
 
 createHashTable:
+	xor ecx, ecx            # flags = 0
+	jmp createHashTableWithFlags
+
+createHashTableWithFlags:
     # Initialization
-	sub rsp, 56
-	mov [rsp], r12d         # 32b size
-	mov [rsp+4], r13        # 64b hash function
-	mov [rsp+12], r14       # 64b equal function pointer
-	mov [rsp+20], r15       # hashtable
+	sub rsp, 40
+	mov [rsp], r12          # 32b size
+	mov [rsp+8], r13        # 64b hash function
+	mov [rsp+16], r14       # 64b equal function pointer
+	mov [rsp+24], r15       # hashtable
+	mov [rsp+32], rbx       # 32b flags
 
 	mov r12d, edi           # Put the size argument into r12
 	mov r13, rsi			# Put the hash function pointer into r13
 	mov r14, rdx			# Put the equal function pointer into r14
+	mov ebx, ecx			# Put the flags into rbx
+
+	test ebx, 4             # HASHTABLE_POW2: round the size up to a power of two
+	jz allocate
+	mov eax, 1
+roundup:
+	cmp eax, r12d           # done once eax >= size
+	jae rounded
+	shl eax, 1              # eax *= 2
+	jmp roundup
+rounded:
+	mov r12d, eax           # size = the power of two
 
-	mov edi, 32 			# set the arguments to call calloc for the hash table
+allocate:
+	mov edi, 40 			# set the arguments to call calloc for the hash table
 	mov esi, 1
 	call calloc             # Space allocation
 	mov r15, rax			# Put the pointer to the allocated space in r15
@@ -46,7 +75,8 @@ createHashTable:
 	mov [r15+8], r14		# equal function = r14
 	mov [r15+24], r12d 		# hash table size = r12d
 	xor r10d, r10d          # zero out r10
-    mov [r15+28], r10d      # used = 32b 0
+	mov [r15+28], r10d      # used = 32b 0
+	mov [r15+32], ebx       # flags = ebx
 	mov edi, r12d			# Set the arguments to call calloc for the data
 	mov esi, 8
 	call calloc             # Space allocation (zeroes out all data)
@@ -54,11 +84,113 @@ createHashTable:
 	mov rax, r15			# return value = hash table
 
     # Restoration
-	mov r12d, [rsp]
-	mov r13, [rsp+4]
-	mov r14, [rsp+12]
-	mov r15, [rsp+20]
-	add rsp, 56
+	mov r12, [rsp]
+	mov r13, [rsp+8]
+	mov r14, [rsp+16]
+	mov r15, [rsp+24]
+	mov rbx, [rsp+32]
+	add rsp, 40
+	ret
+
+/*
+ * Local helper, not called from C: rdx = the bucket index of the hash in
+ * rax for the table in rdi.  Clobbers rax and rcx.
+ */
+bucketIndex:
+	test dword ptr [rdi+32], 4  # HASHTABLE_POW2?
+	jnz mixindex
+	mov ecx, [rdi+24]		# rcx = hash table size
+	xor rdx, rdx			# zero out upper bits for division
+	div rcx					# divide the hash by size, remainder goes into rdx
+	ret
+mixindex:
+	mov rcx, rax			# murmur3 finalizer: hash ^= hash >> 33
+	shr rcx, 33
+	xor rax, rcx
+	mov rcx, 0xff51afd7ed558ccd
+	imul rax, rcx			# hash *= 0xff51afd7ed558ccd
+	mov rcx, rax			# hash ^= hash >> 33
+	shr rcx, 33
+	xor rax, rcx
+	mov rcx, 0xc4ceb9fe1a85ec53
+	imul rax, rcx			# hash *= 0xc4ceb9fe1a85ec53
+	mov rcx, rax			# hash ^= hash >> 33
+	shr rcx, 33
+	xor rax, rcx
+	mov edx, [rdi+24]		# rdx = size - 1
+	sub edx, 1
+	and rdx, rax			# rdx = mixed hash & (size - 1)
+	ret
+
+/*
+ * Local helper, not called from C: eax = the 16 bit HashNode fragment of
+ * the hash in rax, its four quarters xored together.  Clobbers rcx.
+ */
+hashFragment:
+	mov rcx, rax			# hash ^= hash >> 32
+	shr rcx, 32
+	xor rax, rcx
+	mov ecx, eax			# hash ^= hash >> 16
+	shr ecx, 16
+	xor eax, ecx
+	movzx eax, ax			# keep the low 16 bits
+	ret
+
+/*
+ * Local helper: rax = the data of the key in rsi, or 0, searching the
+ * HashNode chain in rcx of the table in rdi for the hash in rdx.  Saves
+ * the registers C expects saved, as the equal function is called.
+ */
+findNode:
+    # Initialization
+	sub rsp, 40
+	mov [rsp], r12          # 64b hashtable pointer
+	mov [rsp+8], r13        # 64b key pointer
+	mov [rsp+16], r14       # hash node
+	mov [rsp+24], r15       # 16b fragment
+	mov [rsp+32], rbx       # index in the node
+
+	mov r12, rdi			# Put the hash table pointer into r12
+	mov r13, rsi			# Put the key pointer into r13
+	mov r14, rcx			# Put the first hash node into r14
+	mov rax, rdx
+	call hashFragment
+	mov r15d, eax			# r15 = the fragment to look for
+
+nodeloop:
+	cmp r14, 0              # Move on if the hash node is 0
+	je nodemiss
+	xor ebx, ebx            # i = 0
+slotloop:
+	movzx ecx, word ptr [r14+14]	# rcx = count
+	cmp ebx, ecx            # next node once i reaches count
+	jae nodenext
+	cmp r15w, [r14+8+2*rbx]	# skip the equal function if the fragments differ
+	jne slotnext
+	mov rdi, r13			# Set the argument to call the equal function
+	mov rsi, [r14+16+8*rbx]	# rdi and rsi are keys
+	call [r12+8]			# equal function call on the two keys
+	cmp eax, 0              # compare the (32b) result to 0
+	je slotnext
+	mov rax, [r14+40+8*rbx]	# return data[i] when the keys are equal
+	jmp nodedone
+slotnext:
+	add ebx, 1              # i++
+	jmp slotloop
+nodenext:
+	mov r14, [r14]			# go to the next hash node
+	jmp nodeloop
+
+nodemiss:
+	mov rax, 0              # return value = 0
+nodedone:
+    # Restoration
+	mov r12, [rsp]
+	mov r13, [rsp+8]
+	mov r14, [rsp+16]
+	mov r15, [rsp+24]
+	mov rbx, [rsp+32]
+	add rsp, 40
 	ret
 
 insertData:
@@ -68,21 +200,25 @@ insertData:
 	mov [rsp+8], r13        # 64b key pointer
 	mov [rsp+16], r14       # 64b data pointer
 	mov [rsp+24], r15       # hash bucket
+	mov [rsp+32], rbx       # 64b hash
 
 	mov r12, rdi			# Put the table pointer into r12
 	mov r13, rsi			# Put the key pointer into r13
 	mov r14, rdx			# Put the data pointer into r14
 
-	mov edi, 24             # set the arguments to call calloc for the hash bucket
+	test dword ptr [r12+32], 8	# HASHTABLE_UNROLLED?
+	jnz insertnode
+
+	mov edi, 32             # set the arguments to call calloc for the hash bucket
 	mov esi, 1
 	call calloc             # Space allocation
 	mov r15, rax			# Put the hash bucket pointer into r15
 
 	mov rdi, r13            # Set the argument to call the hash function
 	call [r12]				# hash function call on the key pointer
-	mov	r10d, [r12+24]		# r10d = hash table size
-	xor rdx, rdx				# zero out upper bits for division
-	div r10d				# divide the hash by size, remainder goes into rdx
+	mov [r15+24], rax		# keep the hash in the bucket
+	mov rdi, r12
+	call bucketIndex		# rdx = bucket index
 	mov r10, [r12+16]		# r10 = data address
 	mov r11, [(8*rdx)+r10]	# r11 = data pointer
 
@@ -90,7 +226,41 @@ insertData:
 	mov [r15+8], r14		# put the data pointer in
 	mov [r15+16], r11		# Put data address into the next
 	mov [r10+8*rdx], r15	# Put the hash bucket into the hashtable
+	jmp inserted
 
+insertnode:
+	mov rdi, r13            # Set the argument to call the hash function
+	call [r12]				# hash function call on the key pointer
+	mov rbx, rax			# rbx = hash
+	mov rdi, r12
+	call bucketIndex		# rdx = bucket index
+	mov r10, [r12+16]		# r10 = data address
+	lea r15, [r10+8*rdx]	# r15 = address of the bucket slot
+	mov r11, [r15]			# r11 = first hash node of the chain
+	cmp r11, 0              # a new node if the chain is empty
+	je newnode
+	cmp word ptr [r11+14], 3	# or its first node is full
+	jb fillnode
+newnode:
+	mov edi, 64             # set the arguments to call aligned_alloc,
+	mov esi, 64             # one node on one cache line
+	call aligned_alloc      # Space allocation
+	mov r11, [r15]
+	mov [rax], r11			# next = the old first node
+	mov word ptr [rax+14], 0	# count = 0
+	mov [r15], rax			# Put the hash node into the hashtable
+	mov r11, rax
+fillnode:
+	mov r15, r11			# r15 = the node to fill
+	mov rax, rbx
+	call hashFragment		# eax = fragment
+	movzx ecx, word ptr [r15+14]	# rcx = count
+	mov [r15+8+2*rcx], ax	# fragments[count] = fragment
+	mov [r15+16+8*rcx], r13	# keys[count] = key
+	mov [r15+40+8*rcx], r14	# data[count] = data
+	add word ptr [r15+14], 1	# count++
+
+inserted:
 	mov r10d, [r12+28]		# r10d = used
 	add r10d, 1			    # used++
 	mov [r12+28], r10d		# put r10 back in after
@@ -100,52 +270,176 @@ insertData:
 	mov r13, [rsp+8]
 	mov r14, [rsp+16]
 	mov r15, [rsp+24]
+	mov rbx, [rsp+32]
 	add rsp, 56
 	ret
 
 findData:
     # Initialization
-	sub rsp, 24
+	sub rsp, 40
 	mov [rsp], r12          # 64b hashtable pointer
 	mov [rsp+8], r13        # 64b key pointer
 	mov [rsp+16], r14       # hash table
+	mov [rsp+24], r15       # 64b hash
 
 	mov r12, rdi			# Put the hash table pointer into r12
 	mov r13, rsi			# Put the key pointer into r13
 
 	mov rdi, r13			# Set the argument to call the hash function
 	call [r12]				# hash function call on the key pointer
-	mov	r10d, [r12+24]		# r10d = hash table size
-	xor rdx, rdx			# zero out upper bits for division
-	div r10d				# divide the hash by size, remainder goes into rdx
+	mov r15, rax			# r15 = hash
+	mov rdi, r12
+	call bucketIndex		# rdx = bucket index
 	mov r10, [r12+16]		# r10 = data address
 	mov r14, [(8*rdx)+r10]	# r14 = temp hash bucket
 
+	test dword ptr [r12+32], 8	# HASHTABLE_UNROLLED?
+	jz whileloop
+	mov rdi, r12			# search the hash nodes instead
+	mov rsi, r13
+	mov rdx, r15
+	mov rcx, r14
+	call findNode			# rax = data or 0
+	jmp restoration
+
 whileloop:
 	cmp r14, 0              # Move on if the temp hash bucket is 0
 	je next
 
+	cmp [r14+24], r15		# skip the equal function if the hashes differ
+	jne nextbucket
 	mov rdi, r13			# Set the argument to call the equal function
 	mov rsi, [r14]			# rdi and rsi are keys
 	call [r12+8]			# equal function call on the two keys
-	cmp rax, 0              # compare the result to 0
-	cmove r14, [r14+16]		# go to the next hash bucket if not equal (result is 0)
-	je whileloop
+	cmp eax, 0              # compare the (32b) result to 0
+	jne found
+nextbucket:
+	mov r14, [r14+16]		# go to the next hash bucket if not equal (result is 0)
+	jmp whileloop
 
+found:
 	mov rax, [r14+8]		# Move on if the keys are equal (result is not 0)
 	jmp restoration
 next:
     # Restoration after finding nothing
 	mov rax, 0              # return value = 0
+restoration:
+    # Restoration
 	mov r12, [rsp]
 	mov r13, [rsp+8]
 	mov r14, [rsp+16]
-	add rsp, 24
+	mov r15, [rsp+24]
+	add rsp, 40
 	ret
-restoration:
+
+/*
+ * void findDataBatch(HashTable *table, void **keys, void **out, uint64_t n)
+ *
+ * Eight keys at a time: hash them all and prefetch their bucket slots,
+ * then load and prefetch the chain heads, then walk the chains (with
+ * findNode for an unrolled table).  The stack holds the hashes at rsp+48
+ * and the slot, then chain, pointers at rsp+112.
+ */
+findDataBatch:
+    # Initialization
+	sub rsp, 184
+	mov [rsp], r12          # 64b hashtable pointer
+	mov [rsp+8], r13        # 64b keys pointer
+	mov [rsp+16], r14       # 64b out pointer
+	mov [rsp+24], r15       # 64b keys left
+	mov [rsp+32], rbx       # 64b keys in this group
+	mov [rsp+40], rbp       # 64b index in the group
+
+	mov r12, rdi			# Put the table pointer into r12
+	mov r13, rsi			# Put the keys pointer into r13
+	mov r14, rdx			# Put the out pointer into r14
+	mov r15, rcx			# Put the key count into r15
+
+batchgroup:
+	cmp r15, 0              # Done when no keys are left
+	je batchdone
+	mov rbx, 8              # group size = min(8, keys left)
+	cmp r15, rbx
+	cmovb rbx, r15
+
+	xor ebp, ebp            # i = 0
+hashloop:
+	mov rdi, [r13+8*rbp]	# Set the argument to call the hash function
+	call [r12]				# hash function call on keys[i]
+	mov [rsp+48+8*rbp], rax	# hashes[i] = hash
+	mov rdi, r12
+	call bucketIndex		# rdx = bucket index
+	mov r10, [r12+16]		# r10 = data address
+	lea r10, [r10+8*rdx]	# r10 = address of the bucket slot
+	mov [rsp+112+8*rbp], r10
+	prefetcht0 [r10]		# start loading the slot
+	add rbp, 1              # i++
+	cmp rbp, rbx
+	jb hashloop
+
+	xor ebp, ebp            # i = 0
+headloop:
+	mov r10, [rsp+112+8*rbp]
+	mov r10, [r10]			# r10 = first hash bucket of the chain
+	mov [rsp+112+8*rbp], r10
+	cmp r10, 0              # nothing to prefetch for an empty chain
+	je headnext
+	prefetcht0 [r10]		# start loading the first hash bucket
+headnext:
+	add rbp, 1              # i++
+	cmp rbp, rbx
+	jb headloop
+
+	xor ebp, ebp            # i = 0
+walkloop:
+	test dword ptr [r12+32], 8	# HASHTABLE_UNROLLED?
+	jz walkbuckets
+	mov rdi, r12			# search the hash nodes instead
+	mov rsi, [r13+8*rbp]
+	mov rdx, [rsp+48+8*rbp]
+	mov rcx, [rsp+112+8*rbp]
+	call findNode			# out[i] = data or 0
+	mov [r14+8*rbp], rax
+	jmp walknext
+walkbuckets:
+	mov qword ptr [r14+8*rbp], 0	# out[i] = 0 unless found
+chainloop:
+	mov r10, [rsp+112+8*rbp]	# r10 = temp hash bucket
+	cmp r10, 0              # Move on if the temp hash bucket is 0
+	je walknext
+	mov rax, [rsp+48+8*rbp]
+	cmp [r10+24], rax		# skip the equal function if the hashes differ
+	jne chainnext
+	mov rdi, [r13+8*rbp]	# Set the arguments to call the equal function
+	mov rsi, [r10]
+	call [r12+8]			# equal function call on the two keys
+	mov r10, [rsp+112+8*rbp]	# the call clobbered r10
+	cmp eax, 0              # compare the (32b) result to 0
+	je chainnext
+	mov rax, [r10+8]		# out[i] = data when the keys are equal
+	mov [r14+8*rbp], rax
+	jmp walknext
+chainnext:
+	mov r10, [r10+16]		# go to the next hash bucket
+	mov [rsp+112+8*rbp], r10
+	jmp chainloop
+walknext:
+	add rbp, 1              # i++
+	cmp rbp, rbx
+	jb walkloop
+
+	lea r13, [r13+8*rbx]	# keys += group size
+	lea r14, [r14+8*rbx]	# out += group size
+	sub r15, rbx			# keys left -= group size
+	jmp batchgroup
+
+batchdone:
     # Restoration
 	mov r12, [rsp]
 	mov r13, [rsp+8]
 	mov r14, [rsp+16]
-	add rsp, 24
+	mov r15, [rsp+24]
+	mov rbx, [rsp+32]
+	mov rbp, [rsp+40]
+	add rsp, 184
 	ret
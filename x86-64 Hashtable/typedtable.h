@@ -0,0 +1,163 @@
+/*
+ * This is so the C preprocessor does not try to include multiple copies
+ * of the header file if someone uses multiple #include directives.
+ */
+#ifndef _TYPEDTABLE_H_
+#define _TYPEDTABLE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slab.h"
+
+/*
+ * Hash tables specialized at compile time on their key type, data type,
+ * hash and equality.  The generic HashTable calls hashFunction and
+ * equalFunction through pointers on every probe; here they are named
+ * directly, so the compiler can inline them.  The generic void * table
+ * stays the fallback for everything else.
+ *
+ * DEFINE_TYPED_HASHTABLE(Name, KeyType, DataType, hashFunction,
+ *                        equalFunction)
+ * defines the type Name and
+ *
+ *   Name *createName(uint64_t size);
+ *   void insertName(Name *table, KeyType key, DataType data);
+ *   DataType *findName(Name *table, KeyType key);   (NULL if missing)
+ *   void freeName(Name *table);
+ *
+ * where hashFunction is a function or macro uint64_t hashFunction(KeyType)
+ * and equalFunction a function or macro int equalFunction(KeyType,
+ * KeyType).  The layout is the chained table's: buckets come from a slab
+ * pool, keep their hash, and the table has a power of two size and
+ * doubles when more than full.
+ * Inserting a key that already exists is undefined, like insertData.
+ *
+ * For example a table from integers to integers is
+ *
+ *   DEFINE_TYPED_HASHTABLE(IntTable, int64_t, int64_t, typedIntHash,
+ *                          typedIntEqual)
+ */
+
+/*
+ * Ready made hashes and equalities for the two common key types.
+ */
+static inline uint64_t typedIntHash(int64_t key) {
+  return (uint64_t)key;
+}
+
+static inline int typedIntEqual(int64_t a, int64_t b) {
+  return a == b;
+}
+
+/*
+ * djb2, one byte at a time (unlike philspel's stringHash, which hashes
+ * eight bytes at a time since it moved to wordHash).
+ */
+static inline uint64_t typedStringHash(const char *key) {
+  uint64_t hash = 5381;
+  int c;
+  while ((c = (unsigned char)*key++)) {
+    hash = ((hash << 5) + hash) + c;
+  }
+  return hash;
+}
+
+static inline int typedStringEqual(const char *a, const char *b) {
+  return strcmp(a, b) == 0;
+}
+
+/*
+ * The murmur3 64 bit finalizer, so masking off the low bits still
+ * depends on all the bits of the hash.
+ */
+static inline uint64_t typedMixHash(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+#define DEFINE_TYPED_HASHTABLE(Name, KeyType, DataType, hashFunction,       \
+                               equalFunction)                                \
+  struct Name##Bucket {                                                      \
+    KeyType key;                                                             \
+    DataType data;                                                           \
+    struct Name##Bucket *next;                                               \
+    uint64_t hash;                                                           \
+  };                                                                         \
+                                                                             \
+  typedef struct Name {                                                      \
+    struct Name##Bucket **data;                                              \
+    uint64_t size;                                                           \
+    uint64_t used;                                                           \
+    SlabPool buckets;                                                        \
+  } Name;                                                                    \
+                                                                             \
+  static inline Name *create##Name(uint64_t size) {                          \
+    Name *newTable = malloc(sizeof(Name));                                   \
+    newTable->size = 1;                                                      \
+    while (newTable->size < size) {                                          \
+      newTable->size *= 2;                                                   \
+    }                                                                        \
+    newTable->used = 0;                                                      \
+    newTable->data =                                                         \
+        calloc(newTable->size, sizeof(struct Name##Bucket *));               \
+    initSlabPool(&newTable->buckets, sizeof(struct Name##Bucket));           \
+    return newTable;                                                         \
+  }                                                                          \
+                                                                             \
+  static inline void free##Name(Name *table) {                               \
+    freeSlabPool(&table->buckets);                                           \
+    free(table->data);                                                       \
+    free(table);                                                             \
+  }                                                                          \
+                                                                             \
+  static inline void insert##Name(Name *table, KeyType key, DataType data) { \
+    struct Name##Bucket *newBucket = NULL;                                   \
+    uint64_t location = 0;                                                   \
+    if (table->used > table->size) {                                         \
+      struct Name##Bucket **oldData = table->data;                           \
+      uint64_t oldSize = table->size;                                        \
+      uint64_t i = 0;                                                        \
+      table->size *= 2;                                                      \
+      table->data = calloc(table->size, sizeof(struct Name##Bucket *));      \
+      for (i = 0; i < oldSize; ++i) {                                        \
+        struct Name##Bucket *at = oldData[i];                                \
+        struct Name##Bucket *next = NULL;                                    \
+        while (at != NULL) {                                                 \
+          next = at->next;                                                   \
+          location = typedMixHash(at->hash) & (table->size - 1);             \
+          at->next = table->data[location];                                  \
+          table->data[location] = at;                                        \
+          at = next;                                                         \
+        }                                                                    \
+      }                                                                      \
+      free(oldData);                                                         \
+    }                                                                        \
+    newBucket = slabAlloc(&table->buckets);                                  \
+    newBucket->key = key;                                                    \
+    newBucket->data = data;                                                  \
+    newBucket->hash = hashFunction(key);                                     \
+    location = typedMixHash(newBucket->hash) & (table->size - 1);            \
+    newBucket->next = table->data[location];                                 \
+    table->data[location] = newBucket;                                       \
+    table->used += 1;                                                        \
+  }                                                                          \
+                                                                             \
+  static inline DataType *find##Name(Name *table, KeyType key) {             \
+    uint64_t keyHash = hashFunction(key);                                    \
+    struct Name##Bucket *lookAt =                                            \
+        table->data[typedMixHash(keyHash) & (table->size - 1)];              \
+    while (lookAt != NULL) {                                                 \
+      if (lookAt->hash == keyHash && equalFunction(key, lookAt->key)) {      \
+        return &lookAt->data;                                                \
+      }                                                                      \
+      lookAt = lookAt->next;                                                 \
+    }                                                                        \
+    return NULL;                                                             \
+  }
+
+#endif